@@ -10,27 +10,79 @@
  *     O(sqrt(mod)) + O(max(p_i^q_i)) to pre-process
  *     O(m * (log(n) + log(k))) roughly for each n choose k query
  *
+ * Each prime power keeps a table of factorials with the multiples of p removed and a table of their inverses
+ * So a query is only table lookups and multiplications, there are no modular exponentiations or hardware divisions
+ * The valuation of p in n choose k is found once by counting carries, stopping early once the result must be 0
+ * Prime factors use the Lucas theorem over the base p digits, and when n < p the answer is just
+ * fact[n] * inv[k] * inv[n - k], which covers every query below a prime modulus
+ *
+ * binomial(queries) answers a batch in blocks, one prime power at a time so its tables stay hot, prefetching the table
+ * entries of the upcoming queries
+ *
+ * Tables are built lazily for the prime powers that are needed, since they take 8 * p^q bytes
+ * save(path) builds all of them and writes them to a file, load(path) maps that file back in with mmap
+ * So a process can start answering queries without rebuilding the tables, and the pages are shared between processes
+ *
+ * Every prime power must be less than 2^32 and mod must be less than 2^63
+ *
 ***/
 
 #include <bits/stdc++.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define BINOMIAL_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 
+/// Division and remainder by a fixed d < 2^32 using a precomputed reciprocal, the estimate is off by at most one
+struct FastDiv{
+    uint64_t d, m;
+
+    FastDiv(): d(1), m(0){}
+    FastDiv(uint64_t d): d(d), m(~0ULL / d){}
+
+    inline uint64_t div(uint64_t x) const{
+        uint64_t r = (__uint128_t)x * m >> 64;
+        return r + (x - r * d >= d);
+    }
+
+    inline uint64_t mod(uint64_t x) const{
+        uint64_t r = x - (uint64_t)((__uint128_t)x * m >> 64) * d;
+        return r >= d ? r - d : r;
+    }
+};
+
 struct BinomialPrimePow{
     uint32_t p, q, mod;
-    vector<uint32_t> dp;
-
-    uint64_t get_tz(uint64_t x){
-        uint64_t res = 0;
-        while (x){
-            x /= p;
-            res += x;
+    FastDiv by_p, by_mod;
+    vector<uint32_t> pw;
+
+    /// fact[i] is the product of the numbers up to i that are not multiples of p, inv[i] is its inverse
+    /// Points to either an owned buffer or into a shared mapping, so copies stay valid
+    shared_ptr<const uint32_t> table;
+    const uint32_t *fact = 0, *inv = 0;
+
+    /// Valuation of p in n choose k, by Kummer's theorem the number of carries when adding k and n - k in base p
+    /// Stops as soon as it reaches q, since the binomial is 0 modulo p^q from there on
+    uint64_t valuation(uint64_t n, uint64_t k) const{
+        uint64_t a, b, m = n - k, t = 0, carry = 0;
+        if (p == 2) return __builtin_popcountll(k) + __builtin_popcountll(m) - __builtin_popcountll(n);
+
+        while ((k | m) && t < q){
+            a = by_p.div(k), b = by_p.div(m);
+            carry = (k - a * p) + (m - b * p) + carry >= p;
+            t += carry, k = a, m = b;
         }
 
-        return res;
+        return t;
     }
 
-    uint64_t expo(uint64_t x, uint64_t n){
+    uint64_t expo(uint64_t x, uint64_t n) const{
         x %= mod;
         uint64_t res = 1;
 
@@ -43,77 +95,127 @@ struct BinomialPrimePow{
         return res % mod;
     }
 
-    uint64_t fact(uint64_t x){
+    /// Product of the numbers up to x with all factors of p removed, or its inverse when t = inv
+    /// fact[mod - 1] is +1 or -1 by the generalized Wilson's theorem, hence it is its own inverse
+    uint64_t walk(uint64_t x, const uint32_t* t) const{
         uint64_t d, res = 1;
 
         while (x >= p){
-            d = x / mod;
-            if (d & 1) res = res * dp[mod - 1] % mod;
-            res = res * dp[x - d * mod] % mod;
-            x /= p;
+            d = by_mod.div(x);
+            if (d & 1) res = by_mod.mod(res * t[mod - 1]);
+            res = by_mod.mod(res * t[x - d * mod]);
+            x = by_p.div(x);
         }
 
-        return res * dp[x] % mod;
+        return by_mod.mod(res * t[x]);
     }
 
-    BinomialPrimePow(uint32_t p, uint32_t q): p(p), q(q){
-        this->mod = pow(p, q) + 0.25;
+    void use_table(shared_ptr<const uint32_t> ptr){
+        table = ptr;
+        fact = table.get(), inv = table.get() + mod;
     }
 
-    int64_t binomial(int64_t n, int64_t k){
-        uint64_t t = get_tz(n) - get_tz(k) - get_tz(n - k);
-        if (t >= q) return 0;
+    void build(){
+        uint32_t* ar = new uint32_t[2ULL * mod];
+        uint32_t *f = ar, *g = ar + mod;
 
-        if (!dp.size()){
-            dp.resize(mod, 1);
-            for (uint32_t i = 1, r = 1; i < mod; i++, r++){
-                if (r == p) r = 0;
-                dp[i] = (uint64_t)dp[i - 1] * (r ? i : 1) % mod;
-            }
+        f[0] = 1;
+        for (uint32_t i = 1, r = 1; i < mod; i++, r++){
+            if (r == p) r = 0;
+            f[i] = (uint64_t)f[i - 1] * (r ? i : 1) % mod;
         }
 
-        uint64_t m = fact(k) * fact(n - k) % mod;
-        uint64_t v = fact(n) * expo(m, (mod / p) * (p - 1) - 1) % mod;
-        return v * expo(p, t) % mod;
+        g[mod - 1] = expo(f[mod - 1], (mod / p) * (p - 1) - 1);
+        for (uint32_t i = mod - 1, r = i % p; i > 0; i--, r--){
+            g[i - 1] = (uint64_t)g[i] * (r ? i : 1) % mod;
+            if (!r) r = p;
+        }
+
+        use_table(shared_ptr<const uint32_t>(ar, default_delete<uint32_t[]>()));
+    }
+
+    BinomialPrimePow(uint32_t p, uint32_t q): p(p), q(q), mod(1){
+        for (uint32_t i = 0; i < q; i++){
+            pw.push_back(mod);
+            assert((uint64_t)mod * p < (1ULL << 32));
+            mod *= p;
+        }
+        by_p = FastDiv(p), by_mod = FastDiv(mod);
+    }
+
+    /// Lucas theorem for q = 1, the product of the binomials of the base p digits
+    uint32_t lucas(uint64_t n, uint64_t k){
+        uint64_t a, b, x, y, res = 1;
+
+        while (n){
+            a = by_p.div(n), b = by_p.div(k);
+            x = n - a * p, y = k - b * p;
+            if (y > x) return 0;
+
+            if (!fact) build();
+            res = by_mod.mod(by_mod.mod(res * fact[x]) * inv[y]);
+            res = by_mod.mod(res * inv[x - y]);
+            n = a, k = b;
+        }
+
+        return res;
+    }
+
+    /// Expects 0 <= k <= n
+    uint32_t binomial(uint64_t n, uint64_t k){
+        if (n < p){
+            if (!fact) build();
+            return by_mod.mod(by_mod.mod((uint64_t)fact[n] * inv[k]) * inv[n - k]);
+        }
+        if (q == 1) return lucas(n, k);
+
+        uint64_t t = valuation(n, k);
+        if (t >= q) return 0;
+
+        if (!fact) build();
+        uint64_t v = by_mod.mod(walk(n, fact) * walk(k, inv));
+        v = by_mod.mod(v * walk(n - k, inv));
+        return by_mod.mod(v * pw[t]);
     }
 };
 
 struct Binomial{
     uint64_t mod;
     vector<BinomialPrimePow> dp;
-    vector<uint32_t> mods, invs;
+    vector<uint64_t> mods, invs;
 
-    uint32_t extended_gcd(uint32_t a, uint32_t b, uint32_t& x, uint32_t& y){
+    static const int BATCH_SIZE = 1024, PREFETCH_DISTANCE = 8;
+    static const uint32_t PREFETCH_MIN_MOD = 1 << 18;   /// Smaller tables stay in cache, prefetching them only costs divisions
+    static const uint64_t MAGIC = 0x4c41494d4f4e4942ULL;   /// "BINOMIAL"
+
+    int64_t extended_gcd(int64_t a, int64_t b, int64_t& x, int64_t& y){
         if (!b){
             y = 0, x = 1;
             return a;
         }
 
-        uint32_t g = extended_gcd(b, a % b, y, x);
+        int64_t g = extended_gcd(b, a % b, y, x);
         y -= ((a / b) * x);
         return g;
     }
 
-    uint32_t mod_inverse(uint32_t a, uint32_t m){
-        uint32_t x, y, inv;
+    uint64_t mod_inverse(uint64_t a, uint64_t m){
+        int64_t x, y;
         extended_gcd(a, m, x, y);
-        inv = (x + m) % m;
-        return inv;
+        return (x % (int64_t)m + m) % m;
     }
 
-    uint64_t chinese_remainder(const vector<uint32_t>& rem){
-        uint64_t res = 0;
-        for (uint32_t i = 0; i < rem.size(); i++){
-            res = (res + (((uint64_t)mods[i] * rem[i] % mod) * invs[i])) % mod;
-        }
-
-        return res;
+    /// Residue of n choose k modulo the i'th prime power, folded into the final result
+    inline uint64_t add_residue(uint64_t res, int i, uint64_t r){
+        res += mods[i] * dp[i].by_mod.mod(r * invs[i]);
+        return res >= mod ? res - mod : res;
     }
 
     Binomial(uint64_t mod): mod(mod){
         uint64_t m = mod;
+        assert(mod < (1ULL << 63));
 
-        for (uint32_t i = 2; i * i <= m; i++){
+        for (uint64_t i = 2; i * i <= m; i++){
             uint32_t c = 0;
             while (m % i == 0){
                 c++;
@@ -123,22 +225,128 @@ struct Binomial{
         }
         if (m > 1) dp.push_back(BinomialPrimePow(m, 1));
 
-        for (auto d: dp){
-            m = pow(d.p, d.q) + 0.25;
-            mods.push_back(mod / m);
-            invs.push_back(mod_inverse(mod / m, m));
+        for (auto& d: dp){
+            mods.push_back(mod / d.mod);
+            invs.push_back(mod_inverse(mod / d.mod % d.mod, d.mod));
         }
     }
 
     int64_t binomial(int64_t n, int64_t k){
         if (k > n || n < 0 || k < 0 || !dp.size()) return 0;
         if (n == k || k == 0) return 1;
+        if (dp.size() == 1) return dp[0].binomial(n, k);
 
-        vector<uint32_t> rem;
+        uint64_t res = 0;
+        for (uint32_t i = 0; i < dp.size(); i++){
+            res = add_residue(res, i, dp[i].binomial(n, k));
+        }
+        return res;
+    }
+
+    /***
+     *
+     * Answers a batch of queries, same as calling binomial(n, k) for each of them
+     * Each block of BATCH_SIZE queries is swept once per prime power, prefetching the table entries a few queries ahead
+     *
+    ***/
+    vector<int64_t> binomial(const vector<pair<int64_t, int64_t>>& queries){
+        int q = queries.size();
+        vector<int64_t> res(q, 0);
+        if (!dp.size()) return res;
+
+        auto valid = [&](int j){
+            return j < q && queries[j].second >= 0 && queries[j].second <= queries[j].first;
+        };
+
+        for (int lo = 0; lo < q; lo += BATCH_SIZE){
+            int hi = min(q, lo + BATCH_SIZE);
+
+            for (uint32_t i = 0; i < dp.size(); i++){
+                BinomialPrimePow& d = dp[i];
+                bool fetch = d.fact && d.mod >= PREFETCH_MIN_MOD;
+
+                for (int j = lo; j < hi; j++){
+                    /// Written out here, GCC treats prefetching as free of side effects and drops calls to a helper doing it
+                    if (fetch && valid(j + PREFETCH_DISTANCE)){
+                        uint64_t n = queries[j + PREFETCH_DISTANCE].first, k = queries[j + PREFETCH_DISTANCE].second;
+                        __builtin_prefetch(d.fact + d.by_mod.mod(n));
+                        __builtin_prefetch(d.inv + d.by_mod.mod(k));
+                        __builtin_prefetch(d.inv + d.by_mod.mod(n - k));
+                    }
+                    if (!valid(j)) continue;
+
+                    uint32_t r = d.binomial(queries[j].first, queries[j].second);
+                    res[j] = dp.size() == 1 ? r : add_residue(res[j], i, r);
+                }
+            }
+        }
+
+        return res;
+    }
+
+    /// Builds the tables of every prime power and writes them to path, returns false on failure
+    bool save(const char* path){
+        FILE* out = fopen(path, "wb");
+        if (!out) return false;
+
+        uint64_t header[3] = {MAGIC, mod, dp.size()};
+        bool ok = fwrite(header, sizeof(header), 1, out) == 1;
+
+        for (auto& d: dp){
+            uint32_t pq[2] = {d.p, d.q};
+            ok = ok && fwrite(pq, sizeof(pq), 1, out) == 1;
+        }
+        for (auto& d: dp){
+            if (!d.fact) d.build();
+            ok = ok && fwrite(d.fact, sizeof(uint32_t), 2ULL * d.mod, out) == 2ULL * d.mod;
+        }
+
+        return fclose(out) == 0 && ok;
+    }
+
+    /// Maps the tables written by save(path) for the same mod, returns false if the file is missing or does not match
+    bool load(const char* path){
+        uint64_t len = 24 + 8 * dp.size();
+        for (auto& d: dp) len += 8ULL * d.mod;
+
+#ifdef BINOMIAL_MMAP
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        void* addr = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (uint64_t)st.st_size == len){
+            addr = mmap(0, len, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (addr == MAP_FAILED) return false;
+
+        shared_ptr<const char> data((const char*)addr, [len](const char* ptr){ munmap((void*)ptr, len); });
+#else
+        FILE* in = fopen(path, "rb");
+        if (!in) return false;
+
+        char* buffer = new char[len + 1];
+        shared_ptr<const char> data(buffer, default_delete<char[]>());
+        bool ok = fread(buffer, 1, len + 1, in) == len;
+        fclose(in);
+        if (!ok) return false;
+#endif
+
+        const uint64_t* header = (const uint64_t*)data.get();
+        const uint32_t* pq = (const uint32_t*)(header + 3);
+        if (header[0] != MAGIC || header[1] != mod || header[2] != dp.size()) return false;
         for (uint32_t i = 0; i < dp.size(); i++){
-            rem.push_back(dp[i].binomial(n, k));
+            if (pq[2 * i] != dp[i].p || pq[2 * i + 1] != dp[i].q) return false;
         }
-        return chinese_remainder(rem);
+
+        const uint32_t* ptr = pq + 2 * dp.size();
+        for (auto& d: dp){
+            d.use_table(shared_ptr<const uint32_t>(data, ptr));
+            ptr += 2ULL * d.mod;
+        }
+
+        return true;
     }
 };
 
@@ -157,11 +365,18 @@ int main(){
             }
         }
 
+        vector<pair<int64_t, int64_t>> queries;
         for (int n = 0; n < 30; n++){
             for (int k = 0; k < 30; k++){
                 assert(dp[n][k] == bin.binomial(n, k));
+                queries.push_back({n, k});
             }
         }
+
+        auto res = bin.binomial(queries);
+        for (int i = 0; i < (int)queries.size(); i++){
+            assert(res[i] == dp[queries[i].first][queries[i].second]);
+        }
     }
 
     assert(Binomial(253).binomial(10, 5) == 252);
@@ -172,6 +387,47 @@ int main(){
     assert(Binomial(1000000007 * 997LL).binomial(1000000000000000000LL, 10000000009LL) == 361000002527LL);
     assert(Binomial(1000000007 * 997LL).binomial(1000000000000000000LL, 1000) == 625000004375LL);
 
-    fprintf(stderr, "\nTime taken = %0.3f\n", (clock()-start) / (double)CLOCKS_PER_SEC); /// 0.010 s
+    /// n choose 2 = n * (n - 1) / 2, checks the chinese remainder step does not overflow with large mods
+    auto big = Binomial(10007LL * 1000003 * 1000033);
+    for (int64_t n = 2000000; n < 2000100; n++){
+        assert(big.binomial(n, 2) == (int64_t)((__int128)n * (n - 1) / 2 % big.mod));
+    }
+
+    auto bin = Binomial(1000003);
+    assert(bin.binomial(1000002, 500001) == 1000002);
+    assert(bin.binomial({{1000002, 500001}, {1000003, 1}, {5, 7}, {-1, 0}}) == vector<int64_t>({1000002, 0, 0, 0}));
+
+    mt19937_64 rng(0);
+    vector<pair<int64_t, int64_t>> queries;
+    auto composite = Binomial(2 * 2 * 2 * 3 * 3 * 7 * 11 * 13 * 13 * 17 * 10007LL);
+
+    for (int i = 0; i < 2000; i++){
+        int64_t n = rng() % (i & 1 ? 1000000000000000000LL : 100000);
+        queries.push_back({n, rng() % (n + 1)});
+    }
+
+    auto res = composite.binomial(queries);
+    for (int i = 0; i < (int)queries.size(); i++){
+        assert(res[i] == composite.binomial(queries[i].first, queries[i].second));
+    }
+
+    const char* path = "binomial_tables.bin";
+    assert(composite.save(path));
+
+    auto mapped = Binomial(composite.mod);
+    assert(mapped.load(path) && !Binomial(composite.mod + 2).load(path));
+    assert(mapped.binomial(queries) == res);
+    remove(path);
+
+    queries.clear();
+    for (int i = 0; i < 2000000; i++){
+        int64_t n = rng() % 1000000000000000000LL;
+        queries.push_back({n, rng() % (n + 1)});
+    }
+
+    res = composite.binomial(queries);
+    res = bin.binomial(queries);
+
+    fprintf(stderr, "\nTime taken = %0.3f\n", (clock()-start) / (double)CLOCKS_PER_SEC); /// 0.892 s
     return 0;
 }
@@ -3,15 +3,28 @@
  * Fast i/o with fread and fwrite
  *
  * Function read() can take multiple arguments and returns the number of objects read
- * Works for strings or any integral types (int, long long, __int128 etc)
- * Also works for vector, but the type has to be string or integral
+ * Works for strings, floating point types or any integral types (int, long long, __int128 etc)
+ * Also works for vector, but the type has to be string, floating point or integral
+ *
+ * Integers are parsed 8 digits at a time with a few multiplications on a 64-bit word (SWAR)
+ * Floats and doubles are parsed with the Eisel-Lemire algorithm and are always correctly rounded
  *
  * Function read_line() reads one line at a time
  * It does not skip empty lines
  *
- * Similarly, write() can take multiple arguments, which can be string or integral
+ * For bulk reads of numbers, read_many(ar, n) reads up to n numbers into an array and returns how many were read
+ * read_line(v) with a vector of numbers reads all of the numbers on the next line into v, reusing its capacity
+ * read_all(v, threads) reads all of the remaining numbers into v, splitting the input at whitespace among several threads
+ * It gives the same numbers in the same order as a sequential read, compile with -pthread on older toolchains
+ *
+ * Similarly, write() can take multiple arguments, which can be string, floating point or integral
  * The write functions prints them separated by a single space, ending with a newline
  *
+ * Integers are formatted two digits at a time straight into the output buffer, with one bounds check per number
+ * Floats and doubles are printed with the fewest digits that read back to the same value (Ryu algorithm)
+ * The output is identical to std::to_chars, the shorter of fixed and scientific notation such as 0.1, 1e+300 or 123456.789
+ * write_many(ar, n) writes n numbers from an array separated by a single space without the trailing newline
+ *
  * The write function also works for vectors just like read
  * Vector elements are separated by a single space and ends with a newline
  *
@@ -19,7 +32,24 @@
  * In other words we can do write(v1, v2, v3) and they will be printed on separate lines
  * It is discouraged to mix vectors with other types in the same write call because of formatting difference
  *
- * Don't forget to flush the buffer at the end after writing
+ * The free functions read from stdin and write to stdout through the global fio::reader and fio::writer
+ * The writer flushes itself on destruction at exit, call flush() earlier in interactive problems
+ *
+ * FastReader and FastWriter objects can be created over any other FILE* (use fdopen for a raw file descriptor)
+ * FastReader(s) reads from a copy of a string or memory buffer, FastWriter(s) appends its output to a string
+ * Each object owns its buffer, whose size is configurable, and shares no state with others
+ * So several files can be read at once, or one shard of the input parsed per thread
+ * They have the same read, read_many, read_line, write, write_many and flush methods as the free functions
+ *
+ * Asynchronous mode, with enable_async() or the async constructor argument, moves the blocking fread and fwrite calls
+ * to a background thread per object, which reads the next buffer ahead and writes full buffers while the program runs
+ * Don't use it for interactive problems, and compile with -pthread on older toolchains
+ * The stream must stay open until the object is destroyed, since a read ahead may still be running until then
+ *
+ * Calling map_input() before reading anything makes the whole input available in memory instead of buffering it
+ * Regular files are memory mapped, other inputs such as pipes are read in large chunks up front
+ * The parsers then scan the input in place and never need to refill
+ * Don't use it for interactive problems as it waits for the end of the input
  *
  * Example usage - Read four numbers till EOF and print their sum
  *
@@ -33,10 +63,26 @@
  *
  * flush();
  *
+ * Example usage - Copy the numbers of a file into a string with objects
+ *
+ * FastReader in(fopen("input.txt", "r"), 1 << 20);
+ * string res;
+ * {
+ *     FastWriter out(res);
+ *     for (long long x; in.read(x); ) out.write(x);
+ * }
+ *
 ***/
 
 #include <bits/stdc++.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 
 /// Because is_integral is not always true for __int128
@@ -47,138 +93,1383 @@ using namespace std;
 #endif
 
 namespace fio{
-    const int BUF_SIZE = 8192;
+    const int BUF_SIZE = 1 << 16, MAX_TOKEN = 64, MAP_CHUNK = 1 << 24, PARALLEL_GRAIN = 1 << 20;
+
+    inline bool is_digit(char c){
+        return (unsigned char)(c - '0') < 10;
+    }
 
-    int buf_len = 0, inptr = 0, outptr = 0;
-    char inbuf[BUF_SIZE], outbuf[BUF_SIZE], tmpbuf[128];
+    inline bool is_space(char c){
+        return c == ' ' || (unsigned char)(c - '\t') < 5;
+    }
 
-    inline char read_char(){
-        if (inptr >= buf_len){
-            inptr = 0, buf_len = fread(inbuf, 1, BUF_SIZE, stdin);
-            if (buf_len == 0) return EOF;
+    /// Function objects rather than functions, so that they are inlined into the scanning loops
+    struct{
+        inline bool operator()(char c) const{
+            return c == '-' || is_digit(c);
         }
+    } integer_start;
 
-        return inbuf[inptr++];
-    }
+    struct{
+        inline bool operator()(char c) const{
+            return !is_space(c) && c;
+        }
+    } token_start;
+
+    namespace{
+        const uint64_t POW10[20] = {
+            1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+            1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+            100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+            1000000000000000000ULL, 10000000000000000000ULL
+        };
+
+        /// Value of the 8 digits of v in the order they appear in memory, any other bytes must be '0' or zero
+        inline uint64_t parse_eight(uint64_t v){
+            v = (v & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+            v = (v & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+            return (v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+        }
 
-    template <typename T, typename=typename enable_if<is_integral<T>::value, T>::type>
-    bool read_one(T &x){
-        int c = ' ', neg = 0;
-        while (c != '-' && !isdigit(c) && c != EOF) c = read_char();
-        if (c == '-') neg = 1, c = read_char();
-        if (c == EOF) return false;
+        /// Number of leading digits among the 8 bytes of v, the first non-digit byte is the first one with its top bit set
+        inline int count_digits(uint64_t v){
+            uint64_t x = v - 0x3030303030303030ULL;
+            x = (x | (x + 0x7676767676767676ULL)) & 0x8080808080808080ULL;
+            return x ? __builtin_ctzll(x) >> 3 : 8;
+        }
+
+        /***
+         *
+         * Parses the digits starting at ptr, 8 at a time, into res and returns the end of them
+         * len is set to the number of digits, res may have wrapped around if there are too many of them
+         *
+         * There is no SSE4 or AVX2 version taking 16 digits at once, a 64-bit integer has at most 20 digits
+         * so it would save at most one step of this loop, and only for numbers of more than 16 digits
+         *
+        ***/
+        template <typename T>
+        inline char* parse_digits(char* ptr, T& res, int& len){
+            uint64_t v;
+            for (len = 0; ; ){
+                memcpy(&v, ptr, 8);
+                int l = count_digits(v);
+                if (!l) break;
 
-        for (x = 0; isdigit(c); c = read_char()){
-            x = x * 10 + c - '0';
+                res = res * (T)POW10[l] + (T)parse_eight(v << (64 - 8 * l));
+                ptr += l, len += l;
+                if (l < 8) break;
+            }
+
+            return ptr;
         }
-        if (neg) x = -x;
 
-        return true;
+        /// Unsigned, so that the digits of the most negative value and its negation do not overflow
+        template <typename T>
+        using accumulator = typename conditional<(sizeof(T) > 8), unsigned __int128, uint64_t>::type;
     }
 
-    bool read_one(string &s){
-        int c = ' ';
-        while (isspace(c) && c != EOF) c = read_char();
-        if (c == EOF) return false;
+    /***
+     *
+     * Floating point numbers are parsed with the Eisel-Lemire algorithm, see https://arxiv.org/abs/2101.11408
+     * The result is always the correctly rounded value, the same as strtod
+     *
+     * The decimal significand w and exponent q are parsed first, then
+     *     If w < 2^53 and |q| <= 22, w * 10^q is computed exactly with a single double operation (Clinger's fast path)
+     *     Otherwise w is multiplied by a 128-bit truncation of 5^q and the result rounded from the top bits
+     * Inputs with more than 19 significant digits, hexadecimal floats, inf and nan, and the rare cases where 128 bits
+     * are not enough to decide the rounding all fall back to strtod
+     *
+    ***/
+    namespace{
+        const int SMALLEST_POWER = -342, LARGEST_POWER = 308;
+
+        /// Little endian big integers with 32-bit limbs, only used to build the tables at startup
+        typedef vector<uint32_t> bigint;
 
-        for (s.clear(); !isspace(c); c = read_char()){
-            s.push_back(c);
+        int bit_length(const bigint& a){
+            for (int i = (int)a.size() - 1; i >= 0; i--){
+                if (a[i]) return 32 * i + 32 - __builtin_clz(a[i]);
+            }
+            return 0;
+        }
+
+        /// Bits [pos, pos + 64) of a, where bits outside of a are zero
+        uint64_t get_bits(const bigint& a, int pos){
+            uint64_t res = 0;
+            for (int i = 63; i >= 0; i--){
+                int j = pos + i;
+                res = res << 1 | (j >= 0 && j < 32 * (int)a.size() && (a[j >> 5] >> (j & 31) & 1));
+            }
+            return res;
+        }
+
+        void multiply(bigint& a, uint32_t m){
+            uint64_t carry = 0;
+            for (auto& x: a) carry += (uint64_t)x * m, x = carry, carry >>= 32;
+            if (carry) a.push_back(carry);
+        }
+
+        void divide(bigint& a, uint32_t d){
+            uint64_t rem = 0;
+            for (int i = (int)a.size() - 1; i >= 0; i--){
+                rem = rem << 32 | a[i];
+                a[i] = rem / d, rem %= d;
+            }
+        }
+
+        /// 2^k as a big integer, with k large enough that 2^k / 5^n rounded down keeps every bit the tables need
+        const int RECIPROCAL_SHIFT = 2048;
+
+        bigint power_of_two(int k){
+            bigint a(k / 32 + 1, 0);
+            a[k >> 5] = 1u << (k & 31);
+            return a;
+        }
+
+        /// The 128 most significant bits of 5^q for q >= 0, and of 2^b / 5^-q rounded up for q < 0
+        /// Built from exact big integers at startup instead of hard-coding 651 pairs of constants
+        struct PowersOfFive{
+            uint64_t hi[LARGEST_POWER - SMALLEST_POWER + 1], lo[LARGEST_POWER - SMALLEST_POWER + 1];
+
+            void set(int q, const bigint& a){
+                int b = bit_length(a);
+                hi[q - SMALLEST_POWER] = get_bits(a, b - 64), lo[q - SMALLEST_POWER] = get_bits(a, b - 128);
+            }
+
+            PowersOfFive(){
+                bigint a = {1};
+                for (int q = 0; q <= LARGEST_POWER; q++){
+                    set(q, a);
+                    multiply(a, 5);
+                }
+
+                /// x = 2^k / 5^n rounded down
+                int k = RECIPROCAL_SHIFT;
+                bigint x = power_of_two(k), p = {1};
+
+                for (int n = 1; n <= -SMALLEST_POWER; n++){
+                    divide(x, 5), multiply(p, 5);
+
+                    /// c = 2^b / 5^n rounded down, plus 1
+                    int z = bit_length(p), b = n <= 27 ? z + 127 : 2 * z + 128, s = k - b;
+                    bigint c(x.size() - s / 32 + 1, 0);
+                    for (int i = 0; i < (int)c.size() - 1; i++){
+                        c[i] = get_bits(x, s + 32 * i) & 0xFFFFFFFFULL;
+                    }
+                    for (int i = 0; i < (int)c.size() && !++c[i]; i++){}
+
+                    set(-n, c);
+                }
+            }
+        } powers_of_five;
+
+        template <typename F> struct FloatFormat;
+
+        template <> struct FloatFormat<double>{
+            typedef uint64_t bits;
+            static const int MANTISSA = 52, MIN_EXPONENT = -1023, INFINITE_POWER = 0x7FF;
+            static const int MIN_ROUND_TO_EVEN = -4, MAX_ROUND_TO_EVEN = 23, MIN_POWER = -342, MAX_POWER = 308;
+            static const int MAX_FAST_EXPONENT = 22;
+            static constexpr double POW[23] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+
+            static double fallback(const char* s){
+                return strtod(s, 0);
+            }
+        };
+
+        template <> struct FloatFormat<float>{
+            typedef uint32_t bits;
+            static const int MANTISSA = 23, MIN_EXPONENT = -127, INFINITE_POWER = 0xFF;
+            static const int MIN_ROUND_TO_EVEN = -17, MAX_ROUND_TO_EVEN = 10, MIN_POWER = -65, MAX_POWER = 38;
+            static const int MAX_FAST_EXPONENT = 10;
+            static constexpr float POW[11] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+            static float fallback(const char* s){
+                return strtof(s, 0);
+            }
+        };
+
+        constexpr double FloatFormat<double>::POW[23];
+        constexpr float FloatFormat<float>::POW[11];
+
+        /// Correctly rounded w * 10^q for w != 0, returns false if it could not be decided
+        template <typename F>
+        bool eisel_lemire(uint64_t w, int64_t q, F& res){
+            typedef FloatFormat<F> Format;
+            typedef typename Format::bits Bits;
+
+            if (w <= (1ULL << (Format::MANTISSA + 1)) && q >= -Format::MAX_FAST_EXPONENT && q <= Format::MAX_FAST_EXPONENT){
+                res = q < 0 ? (F)w / Format::POW[-q] : (F)w * Format::POW[q];
+                return true;
+            }
+
+            uint64_t mantissa = 0;
+            int power2 = 0;
+
+            if (q < Format::MIN_POWER) mantissa = 0, power2 = 0;
+            else if (q > Format::MAX_POWER) mantissa = 0, power2 = Format::INFINITE_POWER;
+            else{
+                int lz = __builtin_clzll(w), index = q - SMALLEST_POWER;
+                w <<= lz;
+
+                __uint128_t product = (__uint128_t)w * powers_of_five.hi[index];
+                uint64_t high = product >> 64, low = product, mask = ~0ULL >> (Format::MANTISSA + 3);
+
+                if ((high & mask) == mask){
+                    uint64_t second = (__uint128_t)w * powers_of_five.lo[index] >> 64;
+                    low += second;
+                    if (second > low) high++;
+                }
+                if (low == ~0ULL && (q < -27 || q > 55)) return false;
+
+                int upper = high >> 63, shift = upper + 64 - Format::MANTISSA - 3;
+                mantissa = high >> shift;
+                power2 = (int)(((152170 + 65536) * q) >> 16) + 63 + upper - lz - Format::MIN_EXPONENT;
+
+                if (power2 <= 0){
+                    if (-power2 + 1 >= 64) mantissa = 0, power2 = 0;
+                    else{
+                        mantissa >>= -power2 + 1;
+                        mantissa += mantissa & 1;
+                        mantissa >>= 1;
+                        power2 = mantissa < (1ULL << Format::MANTISSA) ? 0 : 1;
+                    }
+                }
+                else{
+                    if (low <= 1 && q >= Format::MIN_ROUND_TO_EVEN && q <= Format::MAX_ROUND_TO_EVEN && (mantissa & 3) == 1){
+                        if ((mantissa << shift) == high) mantissa &= ~1ULL;
+                    }
+
+                    mantissa += mantissa & 1;
+                    mantissa >>= 1;
+                    if (mantissa >= (2ULL << Format::MANTISSA)) mantissa = 1ULL << Format::MANTISSA, power2++;
+
+                    mantissa &= ~(1ULL << Format::MANTISSA);
+                    if (power2 >= Format::INFINITE_POWER) mantissa = 0, power2 = Format::INFINITE_POWER;
+                }
+            }
+
+            Bits b = mantissa | ((Bits)power2 << Format::MANTISSA);
+            memcpy(&res, &b, sizeof(res));
+            return true;
         }
-        return true;
     }
 
     template <typename T>
-    bool read_one(vector<T>& v, bool read_length=true){
-        if (read_length){
-            int n;
-            if (!read_one(n)) return false;
-            v.resize(n);
+    struct is_number: integral_constant<bool, is_integral<T>::value || is_same<T, float>::value || is_same<T, double>::value>{};
+
+    namespace{
+        /// Every number is formatted in place, so a single bounds check per value makes room for the widest one
+        const int MAX_WIDTH = 48;
+
+        const char DIGIT_PAIRS[] =
+            "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839" "40414243444546474849"
+            "50515253545556575859" "60616263646566676869" "70717273747576777879" "80818283848586878889" "90919293949596979899";
+
+        inline int digit_count(uint64_t x){
+            int t = (64 - __builtin_clzll(x | 1)) * 1233 >> 12;
+            return max(1, t + (x >= POW10[t]));
         }
 
-        for (auto &&x: v){
-            if (!read_one(x)) return false;
+        /// Writes the digits of x two at a time, ending right before end
+        inline void put_digits(char* end, uint64_t x){
+            while (x >= 100){
+                uint64_t q = x / 100;
+                end -= 2;
+                memcpy(end, DIGIT_PAIRS + 2 * (x - 100 * q), 2);
+                x = q;
+            }
+            if (x >= 10) memcpy(end - 2, DIGIT_PAIRS + 2 * x, 2);
+            else end[-1] = '0' + x;
         }
-        return true;
-    }
 
-    bool read_line(string &s){
-        s.clear();
-        int c = '\n';
-        while (c == '\n' || c == '\r') c = read_char();
+        /// Formats x at p and returns the number of characters written, at most 40 for 128-bit types
+        template <typename T>
+        int format_integer(char* p, T x){
+            typedef typename conditional<(sizeof(T) > 8), unsigned __int128, uint64_t>::type U;
+
+            int len = 0;
+            U u = x;
+            if (is_signed<T>::value && x < 0) u = U(0) - u, p[len++] = '-';
+
+            if (sizeof(T) > 8 && u > ~0ULL){
+                len += format_integer(p + len, (U)(u / POW10[19]));
+                memset(p + len, '0', 19);
+                put_digits(p + len + 19, u % POW10[19]);
+                return len + 19;
+            }
+
+            int d = digit_count(u);
+            put_digits(p + len + d, u);
+            return len + d;
+        }
+
+        /// 5^i and 2^k / 5^i rounded up, both with 125 significant bits, as used by the Ryu algorithm
+        /// See Ulf Adams, Ryu: fast float-to-string conversion (https://dl.acm.org/doi/10.1145/3192366.3192369)
+        const int RYU_POW5_BITS = 125, RYU_POW5_COUNT = 326, RYU_POW5_INV_COUNT = 342;
+
+        inline int pow5_bits(int e){
+            return ((e * 1217359) >> 19) + 1;
+        }
+
+        struct RyuTables{
+            uint64_t pow5[RYU_POW5_COUNT][2], pow5_inv[RYU_POW5_INV_COUNT][2];
+
+            RyuTables(){
+                bigint a = {1};
+                for (int i = 0; i < RYU_POW5_COUNT; i++){
+                    int b = bit_length(a);
+                    pow5[i][0] = get_bits(a, b - RYU_POW5_BITS), pow5[i][1] = get_bits(a, b - RYU_POW5_BITS + 64);
+                    multiply(a, 5);
+                }
+
+                /// x = 2^k / 5^i rounded down, shifted down to pow5_bits(i) - 1 + 125 bits and incremented
+                int k = RECIPROCAL_SHIFT;
+                bigint x = power_of_two(k);
+                for (int i = 0; i < RYU_POW5_INV_COUNT; i++){
+                    int s = k - (pow5_bits(i) - 1 + RYU_POW5_BITS);
+                    pow5_inv[i][0] = get_bits(x, s) + 1, pow5_inv[i][1] = get_bits(x, s + 64) + !pow5_inv[i][0];
+                    divide(x, 5);
+                }
+            }
+        } ryu_tables;
+
+        /// Bits [j, j + 64) of the 192-bit product m * mul
+        inline uint64_t mul_shift(uint64_t m, const uint64_t* mul, int j){
+            unsigned __int128 b0 = (unsigned __int128)m * mul[0], b2 = (unsigned __int128)m * mul[1];
+            return (uint64_t)(((b0 >> 64) + b2) >> (j - 64));
+        }
+
+        inline int pow5_factor(uint64_t x){
+            int res = 0;
+            while (x % 5 == 0) x /= 5, res++;
+            return res;
+        }
+
+        /// The shortest decimal digits * 10^exponent which round back to the given finite, nonzero value
+        /// Ties between equally short candidates go to the one closest to the exact value
+        template <typename F>
+        void shortest_decimal(typename FloatFormat<F>::bits ieee_mantissa, int ieee_exponent, uint64_t& digits, int& exponent){
+            typedef FloatFormat<F> Format;
+            const int BIAS = -Format::MIN_EXPONENT, MANTISSA = Format::MANTISSA;
+
+            uint64_t m2 = ieee_mantissa;
+            int e2 = (ieee_exponent ? ieee_exponent : 1) - BIAS - MANTISSA;
+            if (ieee_exponent) m2 |= 1ULL << MANTISSA;
+
+            /// Integers below 2^(MANTISSA + 1) are printed exactly
+            if (e2 <= 0 && e2 >= -MANTISSA && !(m2 & ((1ULL << -e2) - 1))){
+                digits = m2 >> -e2, exponent = 0;
+                while (digits % 10 == 0) digits /= 10, exponent++;
+                return;
+            }
+
+            /// The interval of decimals rounding to the value is [4 * m2 - 1 - mm_shift, 4 * m2 + 2] * 2^(e2 - 2)
+            e2 -= 2;
+            bool even = !(m2 & 1), vm_zeros = false, vr_zeros = false;
+            uint64_t mv = 4 * m2, mm_shift = ieee_mantissa || ieee_exponent <= 1, vr, vp, vm;
+            int e10, removed = 0;
+            uint8_t last = 0;
+
+            if (e2 >= 0){
+                int q = ((e2 * 78913) >> 18) - (e2 > 3), i = -e2 + q + pow5_bits(q) - 1 + RYU_POW5_BITS;
+                const uint64_t* mul = ryu_tables.pow5_inv[q];
+                vr = mul_shift(mv, mul, i), vp = mul_shift(mv + 2, mul, i), vm = mul_shift(mv - 1 - mm_shift, mul, i);
+                e10 = q;
+
+                if (q <= 21){
+                    if (mv % 5 == 0) vr_zeros = pow5_factor(mv) >= q;
+                    else if (even) vm_zeros = pow5_factor(mv - 1 - mm_shift) >= q;
+                    else vp -= pow5_factor(mv + 2) >= q;
+                }
+            }
+            else{
+                int q = ((-e2 * 732923) >> 20) - (-e2 > 1), i = -e2 - q, j = q - pow5_bits(i) + RYU_POW5_BITS;
+                const uint64_t* mul = ryu_tables.pow5[i];
+                vr = mul_shift(mv, mul, j), vp = mul_shift(mv + 2, mul, j), vm = mul_shift(mv - 1 - mm_shift, mul, j);
+                e10 = q + e2;
+
+                if (q <= 1){
+                    vr_zeros = true;
+                    if (even) vm_zeros = mm_shift == 1;
+                    else vp--;
+                }
+                else if (q < 63) vr_zeros = !(mv & ((1ULL << q) - 1));
+            }
+
+            /// Drop digits while the interval still holds more than one candidate
+            if (vm_zeros || vr_zeros){
+                while (vp / 10 > vm / 10){
+                    vm_zeros &= vm % 10 == 0, vr_zeros &= last == 0;
+                    last = vr % 10, vr /= 10, vp /= 10, vm /= 10, removed++;
+                }
+                if (vm_zeros){
+                    while (vm % 10 == 0){
+                        vr_zeros &= last == 0;
+                        last = vr % 10, vr /= 10, vp /= 10, vm /= 10, removed++;
+                    }
+                }
+                if (vr_zeros && last == 5 && vr % 2 == 0) last = 4;
+                digits = vr + ((vr == vm && (!even || !vm_zeros)) || last >= 5);
+            }
+            else{
+                bool round_up = false;
+                if (vp / 100 > vm / 100){
+                    round_up = vr % 100 >= 50;
+                    vr /= 100, vp /= 100, vm /= 100, removed += 2;
+                }
+                while (vp / 10 > vm / 10){
+                    round_up = vr % 10 >= 5;
+                    vr /= 10, vp /= 10, vm /= 10, removed++;
+                }
+                digits = vr + (vr == vm || round_up);
+            }
+            exponent = e10 + removed;
+        }
+
+        /// Formats x at p with the fewest digits that read back to x and returns the number of characters written
+        /// Like std::to_chars, picks the shorter of fixed and scientific notation, preferring fixed on ties
+        template <typename F>
+        int format_float(char* p, F x){
+            typedef FloatFormat<F> Format;
+            typedef typename Format::bits Bits;
+
+            Bits bits;
+            memcpy(&bits, &x, sizeof(F));
+            Bits mantissa = bits & ((Bits(1) << Format::MANTISSA) - 1);
+            int ieee_exponent = bits >> Format::MANTISSA & Format::INFINITE_POWER, len = 0;
+            if (bits >> (8 * sizeof(F) - 1)) p[len++] = '-';
+
+            if (ieee_exponent == Format::INFINITE_POWER){
+                memcpy(p + len, mantissa ? "nan" : "inf", 3);
+                return len + 3;
+            }
+            if (!ieee_exponent && !mantissa){
+                p[len] = '0';
+                return len + 1;
+            }
+
+            uint64_t digits;
+            int exponent;
+            shortest_decimal<F>(mantissa, ieee_exponent, digits, exponent);
+
+            /// With d digits, the value is 0.000ddd or ddd000 or dd.d in fixed notation and d.dde+XX in scientific
+            int d = digit_count(digits), point = d + exponent, e = point - 1;
+            int fixed = exponent >= 0 ? point : (point > 0 ? d + 1 : 2 - point + d);
+            int scientific = d + (d > 1) + 2 + (abs(e) >= 100 ? 3 : 2);
+
+            if (fixed <= scientific){
+                p += len;
+                if (exponent >= 0){
+                    /// Like std::to_chars, values above 2^(MANTISSA + 1) are printed as the exact integer they hold
+                    int shift = ieee_exponent + Format::MIN_EXPONENT - Format::MANTISSA;
+                    if (shift > 0) format_integer(p, (unsigned __int128)(mantissa | Bits(1) << Format::MANTISSA) << shift);
+                    else put_digits(p + d, digits), memset(p + d, '0', exponent);
+                }
+                else if (point > 0){
+                    put_digits(p + d + 1, digits);
+                    memmove(p, p + 1, point);
+                    p[point] = '.';
+                }
+                else{
+                    memset(p, '0', 2 - point);
+                    p[1] = '.';
+                    put_digits(p + fixed, digits);
+                }
+                return len + fixed;
+            }
 
-        while (c != '\n' && c != '\r' && c != EOF){
-            s.push_back(c);
-            c = read_char();
+            p += len;
+            put_digits(p + d + 1, digits);
+            p[0] = p[1];
+            if (d > 1) p[1] = '.';
+            p += d + (d > 1);
+            *p++ = 'e', *p++ = e < 0 ? '-' : '+';
+            e = abs(e);
+            if (e >= 100) *p++ = '0' + e / 100, e %= 100;
+            memcpy(p, DIGIT_PAIRS + 2 * e, 2);
+            return len + scientific;
         }
-        return c != EOF;
+
+        template <typename T>
+        inline typename enable_if<is_integral<T>::value, int>::type format_number(char* p, T x){
+            return format_integer(p, x);
+        }
+
+        template <typename T>
+        inline typename enable_if<!is_integral<T>::value, int>::type format_number(char* p, T x){
+            return format_float(p, x);
+        }
+    }
+
+    /***
+     *
+     * Runs one job at a time on a background thread, so that reads and writes overlap with parsing and formatting
+     * run() waits for the previous job to finish before handing over the next one
+     *
+    ***/
+    class BackgroundWorker{
+        private:
+            mutex lock;
+            condition_variable cv;
+            function<void()> job;
+            bool busy = false, stop = false;
+            thread worker;
+
+        public:
+            BackgroundWorker(): worker([this](){
+                unique_lock<mutex> guard(lock);
+                while (true){
+                    cv.wait(guard, [this](){ return busy || stop; });
+                    if (!busy) return;
+
+                    guard.unlock();
+                    job();
+                    guard.lock();
+
+                    busy = false;
+                    cv.notify_all();
+                }
+            }){}
+
+            ~BackgroundWorker(){
+                wait();
+                {
+                    lock_guard<mutex> guard(lock);
+                    stop = true;
+                }
+                cv.notify_all();
+                worker.join();
+            }
+
+            void wait(){
+                unique_lock<mutex> guard(lock);
+                cv.wait(guard, [this](){ return !busy; });
+            }
+
+            void run(function<void()> f){
+                wait();
+                {
+                    lock_guard<mutex> guard(lock);
+                    job = move(f), busy = true;
+                }
+                cv.notify_all();
+            }
+    };
+
+    /***
+     *
+     * Reads from a stream, or from a copy of a memory buffer
+     * Every reader owns its buffer and state, so several can be used at once, such as one per thread
+     *
+     * The unread input is [inptr, inend), there is always a '\0' sentinel at inend
+     * Scanning loops run until a byte that does not match, and only check for a refill when that byte is '\0'
+     * At least MAX_TOKEN readable bytes follow inend, so digits can be loaded 8 at a time without going out of bounds
+     *
+     * In asynchronous mode a background thread reads the next chunk into a spare buffer while the current one is parsed
+     * Buffers have MAX_TOKEN bytes of headroom, refill is only called with fewer unread bytes than that left
+     * They are copied in front of the next chunk and the two buffers are swapped, so the chunk itself is never copied
+     *
+    ***/
+    class FastReader{
+        private:
+            FILE* file = 0;
+            bool mapped = false;
+            size_t buf_size = 0, map_len = 0, spare_len = 0;
+            char *storage = 0, *map_addr = 0, *spare = 0, *inbuf, *inptr, *inend;
+            unique_ptr<BackgroundWorker> prefetch;
+
+            void prefetch_next(){
+                prefetch->run([this, ptr = spare + MAX_TOKEN](){
+                    spare_len = fread(ptr, 1, buf_size, file);
+                });
+            }
+
+            /// Moves the unread bytes to the front and fills the rest of the buffer, returns false if nothing is left
+            bool refill(){
+                if (mapped) return inptr < inend;
+
+                size_t len = inend - inptr;
+                if (prefetch){
+                    prefetch->wait();
+
+                    char* data = spare + MAX_TOKEN;
+                    memcpy(data - len, inptr, len);
+                    swap(storage, spare);
+                    inbuf = data, inptr = data - len, inend = data + spare_len;
+                    *inend = 0;
+
+                    prefetch_next();
+                    return inptr < inend;
+                }
+
+                memmove(inbuf, inptr, len);
+                inptr = inbuf, inend = inbuf + len;
+                inend += fread(inend, 1, buf_size - len, file);
+
+                *inend = 0;
+                return inptr < inend;
+            }
+
+            /// Skips bytes until one for which f is true, returns false if the input ended first
+            template <typename F>
+            inline bool skip_until(F f){
+                for (char* ptr = inptr; ; ptr = inptr){
+                    while (!f(*ptr) && *ptr) ptr++;
+
+                    inptr = ptr;
+                    if (*ptr) return true;
+                    if (ptr < inend) inptr++;
+                    else if (!refill()) return false;
+                }
+            }
+
+            /// Skips to the next byte for which f is true, making sure a whole number from there on is in the buffer
+            template <typename F>
+            inline bool next_number(F f){
+                if (!skip_until(f)) return false;
+                if (inend - inptr < MAX_TOKEN) refill();
+                return true;
+            }
+
+            /// Whether inptr is at a '-' ending the input, which is not the start of a number
+            inline bool lone_sign() const{
+                return *inptr == '-' && inptr + 1 == inend;
+            }
+
+            /// Same as next_number(integer_start), except that a '-' ending the input is skipped and not taken as a number
+            inline bool next_integer(){
+                if (!next_number(integer_start)) return false;
+                if (lone_sign()){
+                    inptr++;
+                    return false;
+                }
+                return true;
+            }
+
+            /// Expects inptr to be at the start of a number, as left by next_number()
+            template <typename T>
+            inline void parse_integer(T &x){
+                int len;
+                bool neg = *inptr == '-';
+                accumulator<T> res = 0;
+
+                inptr = parse_digits(inptr + neg, res, len);
+                x = neg ? (T)-res : (T)res;
+            }
+
+            /// Expects inptr to be at the start of a number, as left by next_number()
+            template <typename F>
+            inline void parse_float(F& x){
+                char* ptr = inptr;
+                bool neg = *ptr == '-';
+                uint64_t w = 0;
+                int64_t q = 0;
+                int len, frac = 0, digits = 0;
+
+                char* start = (ptr += neg);
+                while (*ptr == '0') ptr++;
+                ptr = parse_digits(ptr, w, digits);
+                bool valid = ptr > start;
+
+                if (*ptr == '.'){
+                    char* dot = ++ptr;
+                    if (!digits) while (*ptr == '0') ptr++;
+                    ptr = parse_digits(ptr, w, len);
+                    frac = ptr - dot, digits += len, valid |= frac > 0;
+                }
+
+                if (valid && (*ptr | 32) == 'e'){
+                    char* e = ptr++;
+                    bool eneg = *ptr == '-';
+                    ptr += (*ptr == '-' || *ptr == '+');
+
+                    int64_t exponent = 0;
+                    if (!is_digit(*ptr)) ptr = e;
+                    for ( ; is_digit(*ptr); ptr++){
+                        if (exponent < (1LL << 40)) exponent = exponent * 10 + *ptr - '0';
+                    }
+                    q = eneg ? -exponent : exponent;
+                }
+
+                /// Too many digits, hexadecimal, inf or nan, or a number that might continue past the buffer
+                if (!valid || digits > 19 || (ptr == inend && !mapped) || isalpha(*ptr) || (w && !eisel_lemire(w, q - frac, x))){
+                    string s;
+                    read_one(s);
+                    x = FloatFormat<F>::fallback(s.c_str());
+                    return;
+                }
+
+                if (!w) x = 0;
+                if (neg) x = -x;
+                inptr = ptr;
+            }
+
+            /// Skips to the start of the next value of the same type as x
+            template <typename T>
+            inline typename enable_if<is_integral<T>::value, bool>::type next_value(T&){
+                return next_integer();
+            }
+
+            template <typename T>
+            inline typename enable_if<!is_integral<T>::value, bool>::type next_value(T&){
+                return next_number(token_start);
+            }
+
+            template <typename T>
+            inline typename enable_if<is_integral<T>::value, void>::type parse_number(T& x){
+                parse_integer(x);
+            }
+
+            template <typename T>
+            inline typename enable_if<!is_integral<T>::value, void>::type parse_number(T& x){
+                parse_float(x);
+            }
+
+            /// A reader over part of an input already in memory, which owns nothing
+            struct view_tag{};
+
+            FastReader(view_tag, char* begin, char* end): mapped(true){
+                inbuf = inptr = begin, inend = end;
+            }
+
+            /// Parses the numbers which start before stop into res
+            template <typename T>
+            void read_until(const char* stop, vector<T>& res){
+                for (T x; next_value(x) && inptr < stop; res.push_back(x)) parse_number(x);
+            }
+
+        public:
+            /// Buffered reads from a stream, any file descriptor can be wrapped with fdopen()
+            explicit FastReader(FILE* file = stdin, size_t buf_size = BUF_SIZE, bool async = false): file(file){
+                this->buf_size = max(buf_size, (size_t)4 * MAX_TOKEN);
+                storage = (char*)calloc(this->buf_size + 2 * MAX_TOKEN, 1);
+                inbuf = inptr = inend = storage + MAX_TOKEN;
+                if (async) enable_async();
+            }
+
+            /// Reads from a copy of [data, data + len), which gets the sentinel and padding the parsers need
+            FastReader(const char* data, size_t len): mapped(true), buf_size(len){
+                storage = (char*)malloc(len + MAX_TOKEN);
+                memcpy(storage, data, len);
+                memset(storage + len, 0, MAX_TOKEN);
+                inbuf = inptr = storage, inend = storage + len;
+            }
+
+            explicit FastReader(const string& s): FastReader(s.data(), s.size()){}
+
+            FastReader(const FastReader&) = delete;
+            FastReader& operator=(const FastReader&) = delete;
+
+            ~FastReader(){
+                prefetch.reset();
+                free(storage), free(spare);
+#if defined(__unix__) || defined(__APPLE__)
+                if (map_addr) munmap(map_addr, map_len);
+#endif
+            }
+
+            /***
+             *
+             * Switches to reading the whole stream in place, best called before reading anything
+             * Regular files are memory mapped with extra zero pages after them as the sentinel
+             * Otherwise, such as for pipes, everything is read in large chunks into one buffer
+             *
+             * Must not be used for interactive problems, since it waits for the end of the input
+             *
+            ***/
+            void map(){
+                if (mapped) return;
+                if (prefetch) prefetch->wait();
+
+#if defined(__unix__) || defined(__APPLE__)
+                struct stat st;
+                int fd = fileno(file);
+                if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0){
+                    size_t len = st.st_size, page = sysconf(_SC_PAGESIZE);
+                    size_t total = ((len + MAX_TOKEN) / page + 1) * page;
+
+                    char* addr = (char*)mmap(0, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    if (addr != MAP_FAILED && mmap(addr, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED){
+                        madvise(addr, len, MADV_SEQUENTIAL);
+                        map_addr = addr, map_len = total;
+                        inbuf = inptr = addr, inend = addr + len, mapped = true;
+                        prefetch.reset();
+                        return;
+                    }
+                    if (addr != MAP_FAILED) munmap(addr, total);
+                }
+#endif
+
+                /// Keeps whatever was already buffered but not read yet, including a chunk read ahead in asynchronous mode
+                size_t len = inend - inptr, ahead = prefetch ? spare_len : 0, cap = max((size_t)MAP_CHUNK, 2 * (len + ahead));
+                char* ar = (char*)malloc(cap + MAX_TOKEN);
+                memcpy(ar, inptr, len);
+                if (ahead) memcpy(ar + len, spare + MAX_TOKEN, ahead), len += ahead;
+                prefetch.reset();
+
+                for (size_t r; (r = fread(ar + len, 1, cap - len, file)) > 0; ){
+                    len += r;
+                    if (len == cap) ar = (char*)realloc(ar, (cap *= 2) + MAX_TOKEN);
+                }
+
+                memset(ar + len, 0, MAX_TOKEN);
+                free(storage);
+                storage = inbuf = inptr = ar, inend = ar + len, mapped = true;
+            }
+
+            /// Starts reading ahead on a background thread, does nothing once the input is mapped
+            void enable_async(){
+                if (mapped || prefetch) return;
+
+                spare = (char*)calloc(buf_size + 2 * MAX_TOKEN, 1);
+                prefetch.reset(new BackgroundWorker());
+                prefetch_next();
+            }
+
+            inline char read_char(){
+                if (inptr >= inend && !refill()) return EOF;
+                return *inptr++;
+            }
+
+            template <typename T, typename=typename enable_if<is_integral<T>::value, T>::type>
+            bool read_one(T &x){
+                if (!next_integer()) return false;
+                parse_integer(x);
+                return true;
+            }
+
+            bool read_one(string &s){
+                if (!skip_until(token_start)) return false;
+
+                for (s.clear(); ; ){
+                    char* ptr = inptr;
+                    while (*ptr && !is_space(*ptr)) ptr++;
+
+                    s.append(inptr, ptr);
+                    inptr = ptr;
+                    if (*ptr) break;
+                    if (ptr < inend) s.push_back(*inptr++);
+                    else if (!refill()) break;
+                }
+                return true;
+            }
+
+            template <typename T, typename=typename enable_if<is_same<T, float>::value || is_same<T, double>::value, T>::type, typename=void>
+            bool read_one(T &x){
+                if (!next_number(token_start)) return false;
+                parse_float(x);
+                return true;
+            }
+
+            bool read_one(long double &x){
+                string s;
+                if (!read_one(s)) return false;
+
+                x = strtold(s.c_str(), 0);
+                return true;
+            }
+
+            /// Reads up to n numbers into ar in one tight loop and returns how many were read
+            template <typename T>
+            typename enable_if<is_number<T>::value, int>::type read_many(T* ar, int n){
+                for (int i = 0; i < n; i++){
+                    if (!next_value(ar[i])) return i;
+                    parse_number(ar[i]);
+                }
+                return n;
+            }
+
+            template <typename T>
+            typename enable_if<!is_number<T>::value, int>::type read_many(T* ar, int n){
+                for (int i = 0; i < n; i++){
+                    if (!read_one(ar[i])) return i;
+                }
+                return n;
+            }
+
+            /// Reads the numbers up to the end of the line into v, reusing its capacity
+            template <typename T, typename=typename enable_if<is_number<T>::value, T>::type>
+            bool read_line(vector<T>& v){
+                bool found = false;
+                for (v.clear(); skip_until([](char c){ return c != ' ' && c != '\t' && c != '\r'; }); found = true){
+                    if (*inptr == '\n'){
+                        inptr++;
+                        return true;
+                    }
+                    if (is_integral<T>::value && !integer_start(*inptr)){
+                        inptr++;
+                        continue;
+                    }
+
+                    if (inend - inptr < MAX_TOKEN) refill();
+                    if (is_integral<T>::value && lone_sign()){
+                        inptr++;
+                        continue;
+                    }
+                    v.emplace_back();
+                    parse_number(v.back());
+                }
+                return found;
+            }
+
+            template <typename T>
+            bool read_one(vector<T>& v, bool read_length=true){
+                if (read_length){
+                    int n;
+                    if (!read_one(n)) return false;
+                    v.resize(n);
+                }
+
+                return read_many(v.data(), v.size()) == (int)v.size();
+            }
+
+            bool read_line(string &s){
+                s.clear();
+                if (!skip_until([](char c){ return c != '\n' && c != '\r'; })) return false;
+
+                for ( ; ; ){
+                    char* ptr = inptr;
+                    while (*ptr && *ptr != '\n' && *ptr != '\r') ptr++;
+
+                    s.append(inptr, ptr);
+                    inptr = ptr;
+                    if (*ptr) return true;
+                    if (ptr < inend) s.push_back(*inptr++);
+                    else if (!refill()) return false;
+                }
+            }
+
+            /***
+             *
+             * Reads all of the remaining numbers into v in parallel and returns how many were read, same as a read_many() loop
+             * The input is mapped first, then split at whitespace into one chunk per thread, each with at least PARALLEL_GRAIN bytes
+             * Every thread parses the numbers starting in its chunk into its own vector, and they are copied into v in order
+             * The first thread parses straight into v, and capacities are reserved from the density of tokens in a sample
+             *
+            ***/
+            template <typename T>
+            typename enable_if<is_number<T>::value, size_t>::type read_all(vector<T>& v, int threads = thread::hardware_concurrency()){
+                map();
+
+                size_t len = inend - inptr, sample = min(len, (size_t)PARALLEL_GRAIN / 16), tokens = 1;
+                for (size_t i = 1; i < sample; i++) tokens += is_space(inptr[i - 1]) && !is_space(inptr[i]);
+                threads = max<long long>(1, min<long long>(threads, len / PARALLEL_GRAIN));
+
+                vector<char*> bounds(threads + 1, inend);
+                bounds[0] = inptr;
+                for (int t = 1; t < threads; t++){
+                    char* ptr = max(bounds[t - 1], inptr + len * t / threads);
+                    while (ptr < inend && !is_space(*ptr)) ptr++;
+                    bounds[t] = ptr;
+                }
+
+                auto estimate = [&](size_t bytes){
+                    return (size_t)((double)tokens / max(sample, (size_t)1) * bytes * 1.05) + 16;
+                };
+
+                vector<vector<T>> parts(threads);
+                vector<size_t> offset(threads + 1, 0);
+                v.clear(), v.reserve(estimate(len));
+
+                auto parse = [&](int t){
+                    vector<T>& res = t ? parts[t] : v;
+                    if (t) res.reserve(estimate(bounds[t + 1] - bounds[t]));
+
+                    FastReader view(view_tag(), bounds[t], inend);
+                    view.read_until(bounds[t + 1], res);
+                };
+                auto copy = [&](int t){
+                    copy_n(parts[t].data(), parts[t].size(), v.data() + offset[t]);
+                    vector<T>().swap(parts[t]);
+                };
+
+                for (auto step: {0, 1}){
+                    vector<thread> pool;
+                    for (int t = 1; t < threads; t++){
+                        pool.emplace_back([&, t, step](){ step ? copy(t) : parse(t); });
+                    }
+                    if (!step) parse(0);
+                    for (auto&& th: pool) th.join();
+
+                    if (!step){
+                        offset[1] = v.size();
+                        for (int t = 1; t < threads; t++) offset[t + 1] = offset[t] + parts[t].size();
+                        v.resize(offset[threads]);
+                    }
+                }
+
+                inptr = inend;
+                return v.size();
+            }
+
+            int read(){
+                return 0;
+            }
+
+            template <typename T, typename ...Args>
+            int read(T &x, Args& ...args){
+                if (!read_one(x)) return 0;
+                return read(args...) + 1;
+            }
+    };
+
+    /***
+     *
+     * Writes to a stream or appends to a string, flushing when the buffer fills up and on destruction
+     * Like the readers, every writer owns its buffer so several can be used at once
+     *
+     * In asynchronous mode a full buffer is handed to a background thread to be written, and formatting goes on in a spare one
+     *
+    ***/
+    class FastWriter{
+        private:
+            FILE* file = 0;
+            string* str = 0;
+            size_t buf_size, outptr;
+            char *outbuf, *spare = 0;
+            unique_ptr<BackgroundWorker> drain;
+
+            void init(size_t size){
+                buf_size = max(size, (size_t)4 * MAX_WIDTH), outptr = 0;
+                outbuf = (char*)malloc(buf_size);
+            }
+
+        public:
+            /// Buffered writes to a stream, any file descriptor can be wrapped with fdopen()
+            explicit FastWriter(FILE* file = stdout, size_t buf_size = BUF_SIZE, bool async = false): file(file){
+                init(buf_size);
+                if (async) enable_async();
+            }
+
+            /// Appends everything written to s
+            explicit FastWriter(string& s, size_t buf_size = BUF_SIZE): str(&s){
+                init(buf_size);
+            }
+
+            FastWriter(const FastWriter&) = delete;
+            FastWriter& operator=(const FastWriter&) = delete;
+
+            ~FastWriter(){
+                flush();
+                drain.reset();
+                free(outbuf), free(spare);
+            }
+
+            /// Writes to a stream on a background thread from now on, strings are always appended to directly
+            void enable_async(){
+                if (str || drain) return;
+
+                spare = (char*)malloc(buf_size);
+                drain.reset(new BackgroundWorker());
+            }
+
+            /// In asynchronous mode the buffer is only handed over, wait() returns once everything flushed is written
+            void flush(){
+                if (drain){
+                    drain->run([this, ptr = outbuf, len = outptr](){
+                        fwrite(ptr, 1, len, file);
+                    });
+                    swap(outbuf, spare);
+                }
+                else if (str) str->append(outbuf, outptr);
+                else fwrite(outbuf, 1, outptr, file);
+                outptr = 0;
+            }
+
+            void wait(){
+                if (drain) drain->wait();
+            }
+
+            inline void write_char(const char& c){
+                if (outptr == buf_size) flush();
+                outbuf[outptr++] = c;
+            }
+
+            void write_bytes(const char* s, size_t n){
+                while (n){
+                    if (outptr == buf_size) flush();
+                    size_t k = min(n, buf_size - outptr);
+                    memcpy(outbuf + outptr, s, k);
+                    outptr += k, s += k, n -= k;
+                }
+            }
+
+            void write_one(const char* s){
+                write_bytes(s, strlen(s));
+            }
+
+            void write_one(const string& s){
+                write_bytes(s.data(), s.size());
+            }
+
+            template <typename T, typename=typename enable_if<is_number<T>::value, T>::type>
+            void write_one(T x){
+                if (outptr + MAX_WIDTH > buf_size) flush();
+                outptr += format_number(outbuf + outptr, x);
+            }
+
+            /// Long doubles have no shortest formatting here, 21 significant digits always read back to the same value
+            void write_one(long double x){
+                if (outptr + MAX_WIDTH > buf_size) flush();
+                outptr += snprintf(outbuf + outptr, MAX_WIDTH, "%.21Lg", x);
+            }
+
+            /// Writes n numbers separated by sep, with one bounds check per number
+            template <typename T>
+            typename enable_if<is_number<T>::value>::type write_many(const T* ar, int n, char sep = ' '){
+                for (int i = 0; i < n; i++){
+                    if (outptr + MAX_WIDTH + 1 > buf_size) flush();
+                    if (i) outbuf[outptr++] = sep;
+                    outptr += format_number(outbuf + outptr, ar[i]);
+                }
+            }
+
+            template <typename T>
+            typename enable_if<!is_number<T>::value>::type write_many(const T* ar, int n, char sep = ' '){
+                for (int i = 0; i < n; i++){
+                    if (i) write_char(sep);
+                    write_one(ar[i]);
+                }
+            }
+
+            template <typename T>
+            void write_one(const vector<T>& v){
+                write_many(v.data(), v.size());
+            }
+
+            void write_one(const vector<bool>& v){
+                for (int i = 0; i < (int)v.size(); i++){
+                    if (i) write_char(' ');
+                    write_char('0' + v[i]);
+                }
+            }
+
+            void write(){}
+
+            template <typename T, typename ...Args>
+            void write(const T& x, const Args& ...args){
+                write_one(x);
+                write_char(sizeof...(args) && is_trivial<T>::value ? ' ' : '\n');
+                write(args...);
+            }
+    };
+
+    /// The default reader and writer on stdin and stdout, used by the free functions below
+    FastReader reader;
+    FastWriter writer;
+
+    void map_input(){
+        reader.map();
     }
 
-    int read(){
-        return 0;
+    inline char read_char(){
+        return reader.read_char();
     }
 
-    template <typename T, typename ...Args>
-    int read(T &x, Args& ...args){
-        if (!read_one(x)) return 0;
-        return read(args...) + 1;
+    template <typename T>
+    int read_many(T* ar, int n){
+        return reader.read_many(ar, n);
     }
 
-    /* End of read methods, write methods start below */
+    template <typename T>
+    bool read_line(T& x){
+        return reader.read_line(x);
+    }
+
+    template <typename T>
+    size_t read_all(vector<T>& v, int threads = thread::hardware_concurrency()){
+        return reader.read_all(v, threads);
+    }
+
+    template <typename ...Args>
+    int read(Args& ...args){
+        return reader.read(args...);
+    }
 
     void flush(){
-        fwrite(outbuf, 1, outptr, stdout);
-        outptr = 0;
+        writer.flush();
+    }
+
+    /// Overlaps reading stdin and writing stdout with the rest of the program, not for interactive problems
+    void enable_async(){
+        reader.enable_async();
+        writer.enable_async();
     }
 
     inline void write_char(const char& c){
-        if (outptr == BUF_SIZE) flush();
-        outbuf[outptr++] = c;
+        writer.write_char(c);
+    }
+
+    template <typename T>
+    void write_many(const T* ar, int n, char sep = ' '){
+        writer.write_many(ar, n, sep);
     }
 
-    void write_one(const char* s){
-        for (int j = 0; s[j]; j++) write_char(s[j]);
+    template <typename ...Args>
+    void write(const Args& ...args){
+        writer.write(args...);
     }
+}
+
+int main(){
+    using namespace fio;
+
+    /// Integers, with 8 digit blocks, extreme values and signs
+    {
+        string out;
+        vector<long long> values = {0, -1, 7, 12345678, -123456789, 1000000000000LL, LLONG_MAX, LLONG_MIN};
+        __int128 lowest = (__int128)((unsigned __int128)1 << 127);
+        {
+            FastWriter writer(out);
+            writer.write(values);
+            writer.write((__int128)LLONG_MAX * 1000, (unsigned long long)ULLONG_MAX, lowest);
+        }
+        assert(out == "0 -1 7 12345678 -123456789 1000000000000 9223372036854775807 -9223372036854775808\n"
+                      "9223372036854775807000 18446744073709551615 -170141183460469231731687303715884105728\n");
 
-    void write_one(const string& s){
-        for (auto &&c: s) write_char(c);
+        FastReader reader(out);
+        vector<long long> read_back(values.size());
+        __int128 big, low;
+        unsigned long long top;
+        assert(reader.read_many(read_back.data(), values.size()) == (int)values.size() && read_back == values);
+        assert(reader.read(big, top, low) == 3 && big == (__int128)LLONG_MAX * 1000 && top == ULLONG_MAX && low == lowest);
+
+        /// A '-' at the end of the input is not a number, one followed by anything else still reads as 0
+        int a = 7, b = 7, c = 7;
+        FastReader signs(string("- 5 -"));
+        assert(signs.read(a, b, c) == 2 && a == 0 && b == 5 && c == 7);
     }
 
-    template <typename T, typename=typename enable_if<is_integral<T>::value, T>::type>
-    void write_one(T x){
-        if (x < 0) x = -x, write_char('-');
+    /// Floating point tokens which are hard to round, compared with strtod and strtof
+    {
+        vector<string> tokens = {
+            "0", "-0", "1", "0.1", ".5", "5.", "1e", "3.14159e+0", "7.0E-10", "1e23", "9007199254740993", "16777217",
+            "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324", "2.2250738585072011e-308",
+            "2.2250738585072014e-308", "1.7976931348623157e308", "1.7976931348623159e308", "1e400", "-1e400", "1e-400",
+            "1.17549435e-38", "1.4e-45", "3.4028235e38", "3.4028236e38", "123456789012345678901234567890", "0x1p-3",
+            "inf", "-inf", "nan", "0.000000000000000000000000000000000000001234567890123456789"
+        };
+
+        string input;
+        for (auto&& token: tokens) input += token + " ";
 
-        int l = 0;
-        while (x || !l){
-            tmpbuf[l++] = (x % 10) + '0';
-            x /= 10;
+        FastReader doubles(input), floats(input);
+        for (auto&& token: tokens){
+            double x, y = strtod(token.c_str(), 0);
+            float f, g = strtof(token.c_str(), 0);
+            assert(doubles.read(x) && floats.read(f));
+            assert(memcmp(&x, &y, sizeof(x)) == 0 || (isnan(x) && isnan(y)));
+            assert(memcmp(&f, &g, sizeof(f)) == 0 || (isnan(f) && isnan(g)));
         }
-        while (l) write_char(tmpbuf[--l]);
+        double x;
+        assert(!doubles.read(x));
     }
 
-    template <typename T>
-    void write_one(const vector<T>& v){
-        for (int i = 0; i < (int)v.size(); i++){
-            if (i) write_char(' ');
-            write_one(v[i]);
+    /// Shortest formatting, the same strings as std::to_chars, and random values read back to the same bits
+    {
+        string out;
+        {
+            FastWriter writer(out);
+            writer.write(0.1, 1e300, 123456.789, 5e-324, 1e23, 9007199254740993.0, 1.7976931348623157e308, -0.0);
+            writer.write(100.0, 1e16, 2.2250738585072014e-308, 1e21, 123456789012345680.0, 1.5e-7, HUGE_VAL, -HUGE_VAL);
+            writer.write(0.1f, 3.4028235e38f, 1e-45f, 16777216.0f, 1.17549435e-38f, 0.3f, 1e10f);
+        }
+        assert(out == "0.1 1e+300 123456.789 5e-324 1e+23 9007199254740992 1.7976931348623157e+308 -0\n"
+                      "100 1e+16 2.2250738585072014e-308 1e+21 123456789012345680 1.5e-07 inf -inf\n"
+                      "0.1 3.4028235e+38 1e-45 16777216 1.1754944e-38 0.3 1e+10\n");
+
+        mt19937_64 rng(1);
+        vector<double> doubles;
+        vector<float> floats;
+        while (doubles.size() < 20000){
+            uint64_t bits = rng();
+            double d;
+            float f;
+            memcpy(&d, &bits, sizeof(d)), memcpy(&f, &bits, sizeof(f));
+            if (isfinite(d)) doubles.push_back(d);
+            if (isfinite(f)) floats.push_back(f);
+        }
+
+        out.clear();
+        {
+            FastWriter writer(out);
+            writer.write(doubles, floats);
         }
+
+        FastReader reader(out);
+        vector<double> doubles_back;
+        vector<float> floats_back;
+        assert(reader.read_line(doubles_back) && reader.read_line(floats_back));
+        assert(memcmp(doubles.data(), doubles_back.data(), doubles.size() * sizeof(double)) == 0);
+        assert(memcmp(floats.data(), floats_back.data(), floats.size() * sizeof(float)) == 0);
     }
 
-    void write(){}
+    /// Lines of numbers, empty lines stay empty and other characters between integers are skipped
+    {
+        FastReader reader(string("1 2 3\n\n4 x 5\r\n-7"));
+        vector<int> v;
+        assert(reader.read_line(v) && v == vector<int>({1, 2, 3}));
+        assert(reader.read_line(v) && v.empty());
+        assert(reader.read_line(v) && v == vector<int>({4, 5}));
+        assert(reader.read_line(v) && v == vector<int>({-7}));
+        assert(!reader.read_line(v));
 
-    template <typename T, typename ...Args>
-    void write(const T x, const Args ...args){
-        write_one(x);
-        write_char(sizeof...(args) && is_trivial<T>::value ? ' ' : '\n');
-        write(args...);
+        FastReader sign(string("1 2 -"));
+        assert(sign.read_line(v) && v == vector<int>({1, 2}));
     }
-}
 
-int main(){
-    /// SPOJ Enormous Input and Output Test (https://www.spoj.com/problems/INOUTEST/)
+    /// Reading everything on several threads gives the same numbers as reading them one at a time
+    /// The tokens are long, so that the chunks of the threads would start in the middle of one if not moved to whitespace
+    {
+        mt19937_64 rng(2);
+        string input;
+        for (int i = 0; i < 250000; i++) input += to_string((long long)rng()) + (i % 10 ? " " : "\n");
+        input += "\n-";
 
-    using namespace fio;
-    int n, a, b;
+        vector<long long> expected, all;
+        FastReader sequential(input);
+        for (long long x; sequential.read(x); ) expected.push_back(x);
+        for (int threads = 2; threads <= 4; threads++){
+            FastReader parallel(input);
+            assert(parallel.read_all(all, threads) == expected.size() && all == expected);
+        }
+
+        vector<double> expected_doubles, all_doubles;
+        FastReader sequential_doubles(input), parallel_doubles(input);
+        for (double x; sequential_doubles.read(x); ) expected_doubles.push_back(x);
+        parallel_doubles.read_all(all_doubles, 4);
+        assert(all_doubles.size() == expected_doubles.size() && all_doubles == expected_doubles);
+    }
+
+    /// Asynchronous writes and reads through a file, with small buffers so that they are swapped many times
+    {
+        FILE* file = tmpfile();
+        vector<long long> values(100000);
+        for (int i = 0; i < (int)values.size(); i++) values[i] = (long long)i * i * (i & 1 ? -1 : 1);
+        {
+            FastWriter writer(file, 1024, true);
+            for (long long x: values) writer.write(x);
+        }
+
+        rewind(file);
+        vector<long long> read_back;
+        {
+            /// The reader reads ahead even at the end of the input, so it is destroyed before the stream is closed
+            FastReader reader(file, 1024, true);
+            for (long long x; reader.read(x); ) read_back.push_back(x);
+        }
+        assert(read_back == values);
+        fclose(file);
+    }
+
+    /// SPOJ Enormous Input and Output Test (https://www.spoj.com/problems/INOUTEST/)
+    int n = 0, a = 0, b = 0;
 
+    map_input();
     read(n);
     while (n--){
         read(a, b);
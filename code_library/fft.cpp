@@ -1,34 +1,57 @@
 /***
  * Fast Fourier Transformation
  *
- * Uses custom class for complex numbers and various optimizations for better performance
+ * Uses double precision complex numbers stored as separate real and imaginary arrays
+ * The butterflies are vectorized with AVX2 or AVX-512 whenever the CPU supports it, detected at runtime
+ * Otherwise falls back to the scalar implementation, which also works on non x86 machines
+ *
+ * The first few levels are done block by block so that they run inside the cache
+ *
+ * Roots and scratch memory are allocated on the heap the first time a given length is needed and reused afterwards
+ * Every thread gets its own copy, so the exposed methods can be called concurrently from different threads
+ * Call release() to free the memory held by the current thread
+ *
+ * Real inputs use a transform of half the length, with even and odd positions packed as one complex vector
+ * When one side of many multiplications is fixed, transform it once with prepare() and pass it instead
+ *
+ * Circular convolutions of any length return exactly n values, dft() transforms any length with Bluestein's algorithm
+ *
+ * String matching works over any alphabet with wildcards, against a prepared text or a text streamed in blocks
+ *
+ * Short inputs skip the transform and use schoolbook or Karatsuba instead, unbalanced ones are multiplied in chunks
+ * The thresholds between them can be measured on the current machine with tune()
+ *
+ * Large transforms can also be split among several threads with set_threads(), which is off by default
+ * Compile with -pthread in that case on older toolchains
  *
  * Complexity:
- *   - O(MAX log MAX) pre-processing once
- *   - O(n log n) for all exposed methods
+ *   - O(n) pre-processing whenever the transform length exceeds the largest one so far
+ *   - O(n log n) for all exposed methods, O(n m^0.585) when the shorter side m is below the Karatsuba threshold
  *
 ***/
 
 #include <bits/stdc++.h>
 
-#define MAX 2097152
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define FFT_X86_KERNELS
+#endif
 
 using namespace std;
 
-/// Use double to gain more speed at the cost of precision (double should be fine for most problems)
-typedef long double fType;
-
 namespace fft{
     namespace{ /// Anonymous namespace to wrap internally used variables and methods
         const int MOD_SPLIT_LIMIT = 15;
         const int LL_MULTIPLY_MOD = 1500000000;
+        const int BLOCK_SIZE = 4096;
+        const int PARALLEL_GRAIN = 32768;
 
-        int last_len = -1, initialized = 0, rev[MAX];
+        int num_threads = 1;
 
         struct ComplexNum{
-            fType real, img;
+            double real, img;
 
-            inline ComplexNum(fType real=0, fType img=0) : real(real), img(img) {}
+            inline ComplexNum(double real=0, double img=0) : real(real), img(img) {}
 
             inline ComplexNum conjugate(){
                 return ComplexNum(real, -img);
@@ -45,9 +68,9 @@ namespace fft{
             inline ComplexNum operator * (ComplexNum x){
                 return ComplexNum(real * x.real - img * x.img, real * x.img + img * x.real);
             }
-        } u[MAX], w[MAX], f[MAX], g[MAX], dp[MAX], inv[MAX];
+        };
 
-        long long round_to_nearest(const fType& x){
+        long long round_to_nearest(const double& x){
             long long res = abs(x) + 0.5;
             return (x < 0) ? -res : res;
         }
@@ -56,66 +79,249 @@ namespace fft{
             return 32 - __builtin_clz(len) - (__builtin_popcount(len) == 1);
         }
 
-        void initialize(){
-            initialized = 1;
-            dp[1] = inv[1] = ComplexNum(1);
+        /// Split layout of complex numbers, real and imaginary parts are in separate arrays for vectorization
+        struct ComplexArray{
+            vector<double> re, im;
+
+            void resize(int len){
+                if ((int)re.size() < len) re.resize(len), im.resize(len);
+            }
+
+            void release(){
+                vector<double>().swap(re), vector<double>().swap(im);
+            }
+
+            inline ComplexNum operator [] (int i) const{
+                return ComplexNum(re[i], im[i]);
+            }
+
+            inline void set(int i, const ComplexNum& x){
+                re[i] = x.real, im[i] = x.img;
+            }
+        };
+
+        /***
+         * Roots of unity, bit reversal table and scratch arrays for a single thread
+         * roots[k + j] = e^(i * pi * j / k) for every power of two k, computed up to the largest length used so far
+         *
+        ***/
+        struct FftContext{
+            int last_len = -1, root_len = 0;
+            vector<int> rev;
+            ComplexArray roots, u, w, f, g;
+
+            void build_roots(int len){
+                /// Roots are computed with long double and rounded once to keep the error low
+                int i, j, k, lim;
+                vector<long double> re(2, 1), im(2, 0);
+
+                roots.resize(len);
+                roots.re[1] = 1, roots.im[1] = 0;
+                for (i = 1; (1 << i) < len; i++){
+                    long double theta = (long double)2 * acosl(0.0) / (1 << i);
+                    long double mul_re = cosl(theta), mul_im = sinl(theta);
+
+                    lim = 1 << i;
+                    re.resize(2 * lim), im.resize(2 * lim);
+                    for (j = lim >> 1; j < lim; j++){
+                        k = 2 * j;
+                        re[k] = re[j], im[k] = im[j];
+                        re[k + 1] = re[j] * mul_re - im[j] * mul_im;
+                        im[k + 1] = re[j] * mul_im + im[j] * mul_re;
+                    }
+                    for (j = lim; j < 2 * lim; j++) roots.re[j] = re[j], roots.im[j] = im[j];
+                }
+                root_len = len;
+            }
 
-            int i, j, k, lim;
-            for (i = 1; (1 << i) < MAX; i++){
-                fType theta = (fType)2 * acos(0.0) / (1 << i);
-                ComplexNum mul = ComplexNum(cos(theta), sin(theta));
-                ComplexNum inv_mul = ComplexNum(cos(-theta), sin(-theta));
+            /// Bit reversal for transforms of length len, and roots up to max(len, roots_needed)
+            void prepare(int len, int roots_needed=0){
+                if (max(len, roots_needed) > root_len) build_roots(max(len, roots_needed));
+                if (len != last_len){
+                    last_len = len;
+                    rev.assign(len, 0);
 
-                for (lim = 1 << i, j = lim >> 1; j < lim; j++){
-                    k = 2 * j;
-                    dp[k] = dp[j], inv[k] = inv[j];
-                    inv[k + 1] = inv[j] * inv_mul;
-                    dp[k + 1] = dp[j] * mul;
+                    const int bit = get_bit(len);
+                    for (int i = 1; i < len; i++){
+                        rev[i] = (rev[i >> 1] >> 1) + ((i & 1) << (bit - 1));
+                    }
                 }
             }
+
+            void release(){
+                last_len = -1, root_len = 0;
+                vector<int>().swap(rev);
+                roots.release(), u.release(), w.release(), f.release(), g.release();
+            }
+        };
+
+        FftContext& get_context(){
+            static thread_local FftContext ctx;
+            return ctx;
+        }
+
+        int detect_simd_level(){
+#ifdef FFT_X86_KERNELS
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) return 2;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return 1;
+#endif
+            return 0;
         }
 
-        int build(vector<long long>& v1, vector<long long>& v2){
-            int i, n = v1.size(), m = v2.size();
-            while (n > 1 && v1[n - 1] == 0) n--;
-            while (m > 1 && v2[m - 1] == 0) m--;
+        int simd_level = detect_simd_level();
 
-            int len = 1 << get_bit(n + m);
-            v1.resize(len, 0), v2.resize(len, 0);
+        /// Size of v without the trailing zeros, at least 1
+        int trim(const vector<long long>& v){
+            int n = v.size();
+            while (n > 1 && v[n - 1] == 0) n--;
+            return n;
+        }
 
-            if (!initialized) initialize();
-            if (len != last_len){
-                last_len = len;
-                const int bit = get_bit(len);
-                for (i = 0; i < len; i++){
-                    rev[i] = (rev[i >> 1] >> 1) + ((i & 1) << (bit - 1));
-                }
+        /***
+         * Runs func(lo, hi) over disjoint ranges covering [0, n), one range per thread
+         * Stays on the calling thread if there is not at least grain work for every thread
+         *
+        ***/
+        template <typename F>
+        void parallel_for(int n, F func, int grain=PARALLEL_GRAIN){
+            int t, threads = min(num_threads, n / max(grain, 1));
+            if (threads <= 1) return func(0, n);
+
+            vector<thread> pool;
+            for (t = 1; t < threads; t++){
+                pool.emplace_back(func, (int)((long long)n * t / threads), (int)((long long)n * (t + 1) / threads));
             }
+            func(0, n / threads);
+            for (auto&& th: pool) th.join();
+        }
 
-            return len;
+        /// count butterflies (a, b) -> (a + b * c, a - b * c)
+        void butterfly_scalar(double* ar, double* ai, double* br, double* bi, const double* cr, const double* ci, int count){
+            for (int j = 0; j < count; j++){
+                double zr = br[j] * cr[j] - bi[j] * ci[j];
+                double zi = br[j] * ci[j] + bi[j] * cr[j];
+                br[j] = ar[j] - zr, bi[j] = ai[j] - zi;
+                ar[j] += zr, ai[j] += zi;
+            }
         }
 
-        void transform(ComplexNum *in, ComplexNum *out, ComplexNum* ar, int len){
-            for (int i = 0; i < len; i++) out[i] = in[rev[i]];
-            for (int k = 1; k < len; k <<= 1){
-                for (int i = 0; i < len; i += (k << 1)){
-                    ComplexNum z, *a = out + i, *b = out + i + k, *c = ar + k;
-                    if (k == 1){
-                        z = (*b) * (*c);
-                        *b = *a - z, *a = *a + z;
-                    }
+#ifdef FFT_X86_KERNELS
+        __attribute__((target("avx2,fma")))
+        void butterfly_avx2(double* ar, double* ai, double* br, double* bi, const double* cr, const double* ci, int count){
+            int j;
+            for (j = 0; j + 4 <= count; j += 4){
+                __m256d wr = _mm256_loadu_pd(cr + j), wi = _mm256_loadu_pd(ci + j);
+                __m256d xr = _mm256_loadu_pd(br + j), xi = _mm256_loadu_pd(bi + j);
+                __m256d yr = _mm256_loadu_pd(ar + j), yi = _mm256_loadu_pd(ai + j);
+
+                __m256d zr = _mm256_fmsub_pd(xr, wr, _mm256_mul_pd(xi, wi));
+                __m256d zi = _mm256_fmadd_pd(xr, wi, _mm256_mul_pd(xi, wr));
+
+                _mm256_storeu_pd(br + j, _mm256_sub_pd(yr, zr));
+                _mm256_storeu_pd(bi + j, _mm256_sub_pd(yi, zi));
+                _mm256_storeu_pd(ar + j, _mm256_add_pd(yr, zr));
+                _mm256_storeu_pd(ai + j, _mm256_add_pd(yi, zi));
+            }
+            butterfly_scalar(ar + j, ai + j, br + j, bi + j, cr + j, ci + j, count - j);
+        }
 
-                    for (int j = 0; j < k && k > 1; j += 2, a++, b++, c++){
-                        z = (*b) * (*c);
-                        *b = *a - z, *a = *a + z;
-                        a++, b++, c++;
-                        z = (*b) * (*c);
-                        *b = *a - z, *a = *a + z;
-                    }
+        __attribute__((target("avx512f")))
+        void butterfly_avx512(double* ar, double* ai, double* br, double* bi, const double* cr, const double* ci, int count){
+            int j;
+            for (j = 0; j + 8 <= count; j += 8){
+                __m512d wr = _mm512_loadu_pd(cr + j), wi = _mm512_loadu_pd(ci + j);
+                __m512d xr = _mm512_loadu_pd(br + j), xi = _mm512_loadu_pd(bi + j);
+                __m512d yr = _mm512_loadu_pd(ar + j), yi = _mm512_loadu_pd(ai + j);
+
+                __m512d zr = _mm512_fmsub_pd(xr, wr, _mm512_mul_pd(xi, wi));
+                __m512d zi = _mm512_fmadd_pd(xr, wi, _mm512_mul_pd(xi, wr));
+
+                _mm512_storeu_pd(br + j, _mm512_sub_pd(yr, zr));
+                _mm512_storeu_pd(bi + j, _mm512_sub_pd(yi, zi));
+                _mm512_storeu_pd(ar + j, _mm512_add_pd(yr, zr));
+                _mm512_storeu_pd(ai + j, _mm512_add_pd(yi, zi));
+            }
+            butterfly_scalar(ar + j, ai + j, br + j, bi + j, cr + j, ci + j, count - j);
+        }
+#endif
+
+        /// Whole level for small k, where the runs are too short for the dispatch in butterfly()
+        template <int K>
+        void butterfly_small(double* re, double* im, const double* cr, const double* ci, int len){
+            for (int i = 0; i < len; i += 2 * K){
+                double *ar = re + i, *ai = im + i, *br = ar + K, *bi = ai + K;
+                for (int j = 0; j < K; j++){
+                    double zr = br[j] * cr[j] - bi[j] * ci[j];
+                    double zi = br[j] * ci[j] + bi[j] * cr[j];
+                    br[j] = ar[j] - zr, bi[j] = ai[j] - zi;
+                    ar[j] += zr, ai[j] += zi;
                 }
             }
         }
 
+        /***
+         * Butterflies with index in [lo, hi) on the level with blocks of length 2k
+         * The p'th butterfly pairs position (p / k) * 2k + (p % k) with the one k positions after it
+         *
+        ***/
+        void butterfly(double* re, double* im, const FftContext& ctx, int k, int lo, int hi){
+            const double *cr = ctx.roots.re.data() + k, *ci = ctx.roots.im.data() + k;
+
+            for (int p = lo, i, j, count; p < hi; p += count){
+                j = p & (k - 1), i = 2 * (p - j) + j, count = min(k - j, hi - p);
+#ifdef FFT_X86_KERNELS
+                if (simd_level >= 2 && count >= 8){
+                    butterfly_avx512(re + i, im + i, re + i + k, im + i + k, cr + j, ci + j, count);
+                    continue;
+                }
+                if (simd_level >= 1 && count >= 4){
+                    butterfly_avx2(re + i, im + i, re + i + k, im + i + k, cr + j, ci + j, count);
+                    continue;
+                }
+#endif
+                butterfly_scalar(re + i, im + i, re + i + k, im + i + k, cr + j, ci + j, count);
+            }
+        }
+
+        /***
+         * In-place transform, swapping the real and imaginary parts gives the inverse transform (without the 1/len factor)
+         *
+         * Levels with blocks up to BLOCK_SIZE are finished one block at a time, each thread taking a contiguous set of blocks
+         * Every level above that is split into equal ranges of butterflies, one for each thread
+         *
+        ***/
+        void transform(const FftContext& ctx, double* re, double* im, int len){
+            const int* rev = ctx.rev.data();
+            parallel_for(len, [&](int lo, int hi){
+                for (int i = lo; i < hi; i++){
+                    if (i < rev[i]) swap(re[i], re[rev[i]]), swap(im[i], im[rev[i]]);
+                }
+            });
+
+            int block = min(len, BLOCK_SIZE);
+            parallel_for(len / block, [&](int lo, int hi){
+                const double *cr = ctx.roots.re.data(), *ci = ctx.roots.im.data();
+                for (int i = lo * block; i < hi * block; i += block){
+                    if (block >= 2) butterfly_small<1>(re + i, im + i, cr + 1, ci + 1, block);
+                    if (block >= 4) butterfly_small<2>(re + i, im + i, cr + 2, ci + 2, block);
+                    if (block >= 8) butterfly_small<4>(re + i, im + i, cr + 4, ci + 4, block);
+                    for (int k = 8; k < block; k <<= 1) butterfly(re + i, im + i, ctx, k, 0, block >> 1);
+                }
+            }, PARALLEL_GRAIN / block);
+
+            for (int k = block; k < len; k <<= 1){
+                parallel_for(len >> 1, [&](int lo, int hi){
+                    butterfly(re, im, ctx, k, lo, hi);
+                });
+            }
+        }
+
+        void transform(const FftContext& ctx, ComplexArray& ar, int len, bool invert=false){
+            if (invert) transform(ctx, ar.im.data(), ar.re.data(), len);
+            else transform(ctx, ar.re.data(), ar.im.data(), len);
+        }
+
         bool is_equal(const vector <long long>& v1, const vector <long long>& v2){
             if (v1.size() != v2.size()) return false;
 
@@ -132,32 +338,470 @@ namespace fft{
             return true;
         }
 
-        void build_convolution(vector <long long>& v1, vector <long long>& v2){
-            assert(v1.size() == v2.size());
+        /// Transform length for circular convolutions of size n, n itself if it is a power of two or enough for the linear product
+        int circular_length(int n){
+            if (n >= 2 && __builtin_popcount(n) == 1) return n;
+            return max(2, 1 << get_bit(2 * n - 1));
+        }
+
+        /// Wraps res around onto its first n values, reducing modulo mod if it is positive
+        void fold(vector <long long>& res, int n, int mod){
+            for (int i = n; i < (int)res.size(); i++){
+                res[i - n] += res[i];
+                if (mod && res[i - n] >= mod) res[i - n] -= mod;
+            }
+            res.resize(n);
+        }
+
+        /// Combines res1 modulo LL_MULTIPLY_MOD and res2 modulo LL_MULTIPLY_MOD + 1 into res1
+        void combine_ll(vector <long long>& res1, const vector <long long>& res2){
+            const long long mod1 = LL_MULTIPLY_MOD, mod2 = mod1 + 1;
+            assert(res1.size() == res2.size());
+
+            for (int i = 0; i < (int)res1.size(); i++){
+                res1[i] = res1[i] + (res2[i] - res1[i] + mod2) * mod1 % mod2 * mod1;
+            }
+        }
+
+        /***
+         * Spectrum X[0], X[1], ..., X[len / 2] of v[0, n) padded with zeros to len, the rest follows from X[len - k] = conj(X[k])
+         * Even and odd positions are packed into one complex vector, so a single transform of length len / 2 is enough
+         *
+        ***/
+        void real_transform(FftContext& ctx, const long long* v, int n, int len, ComplexArray& res){
+            const int h = len >> 1;
+
+            ctx.prepare(h, len);
+            res.resize(h + 1);
+            parallel_for(h, [&](int lo, int hi){
+                for (int i = lo; i < hi; i++){
+                    res.re[i] = 2 * i < n ? v[2 * i] : 0;
+                    res.im[i] = 2 * i + 1 < n ? v[2 * i + 1] : 0;
+                }
+            });
+            transform(ctx, res, h);
+
+            /// X[k] = E[k] + w^k * O[k], where E[k] = (Z[k] + conj(Z[h - k])) / 2 and O[k] = (Z[k] - conj(Z[h - k])) / 2i
+            ComplexNum z = res[0];
+            res.set(0, ComplexNum(z.real + z.img, 0)), res.set(h, ComplexNum(z.real - z.img, 0));
+            parallel_for(h / 2, [&](int lo, int hi){
+                for (int k = lo + 1; k <= hi; k++){
+                    ComplexNum x = res[k], y = res[h - k];
+                    ComplexNum e1 = (x + y.conjugate()) * ComplexNum(0.5, 0), o1 = (x - y.conjugate()) * ComplexNum(0, -0.5);
+                    ComplexNum e2 = (y + x.conjugate()) * ComplexNum(0.5, 0), o2 = (y - x.conjugate()) * ComplexNum(0, -0.5);
+                    res.set(k, e1 + o1 * ctx.roots[h + k]);
+                    res.set(h - k, e2 + o2 * ctx.roots[len - k]);
+                }
+            });
+        }
+
+        /// Inverse of real_transform, the spectrum is overwritten and the rounded values are written to res (up to res.size())
+        void inverse_real_transform(FftContext& ctx, ComplexArray& ar, int len, vector <long long>& res){
+            const int h = len >> 1, p_len = min(len, (int)res.size());
+
+            ctx.prepare(h, len);
+            ComplexNum x = ar[0], y = ar[h];
+            ar.set(0, (x + y.conjugate()) * ComplexNum(0.5, 0) + (x - y.conjugate()) * ComplexNum(0, 0.5));
+            parallel_for(h / 2, [&](int lo, int hi){
+                for (int k = lo + 1; k <= hi; k++){
+                    ComplexNum x = ar[k], y = ar[h - k];
+                    ComplexNum e1 = (x + y.conjugate()) * ComplexNum(0.5, 0), o1 = (x - y.conjugate()) * ctx.roots[h + k].conjugate();
+                    ComplexNum e2 = (y + x.conjugate()) * ComplexNum(0.5, 0), o2 = (y - x.conjugate()) * ctx.roots[len - k].conjugate();
+                    ar.set(k, e1 + o1 * ComplexNum(0, 0.5));
+                    ar.set(h - k, e2 + o2 * ComplexNum(0, 0.5));
+                }
+            });
+            transform(ctx, ar, h, true);
+
+            parallel_for(p_len, [&](int lo, int hi){
+                for (int i = lo; i < hi; i++){
+                    res[i] = round_to_nearest((i & 1 ? ar.im[i >> 1] : ar.re[i >> 1]) / h);
+                }
+            });
+        }
+
+        /// Transform of (v[i] % mod) & mask + i * ((v[i] % mod) >> bits) for i in [0, n), padded with zeros to len
+        void split_transform(FftContext& ctx, const long long* v, int n, int len, int mod, int bits, ComplexArray& res){
+            const int mask = (1 << bits) - 1;
+
+            ctx.prepare(len);
+            res.resize(len);
+            parallel_for(len, [&](int lo, int hi){
+                for (int i = lo; i < hi; i++){
+                    long long x = i < n ? v[i] % mod : 0;
+                    res.re[i] = x & mask, res.im[i] = x >> bits;
+                }
+            });
+            transform(ctx, res, len);
+        }
+
+        /// Product modulo mod from the split transforms f and g of length len, f is overwritten
+        void split_multiply(FftContext& ctx, ComplexArray& f, const ComplexArray& g, int len, int mod, int bits, vector <long long>& res){
+            const int p_len = min(len, (int)res.size());
+            ComplexArray &u = ctx.u, &w = ctx.w;
+
+            u.resize(len), w.resize(len);
+            parallel_for(len, [&](int lo, int hi){
+                for (int i = lo; i < hi; i++){
+                    int j = (len - 1) & (len - i);
+                    ComplexNum c1 = f[j].conjugate(), c2 = g[j].conjugate();
+
+                    ComplexNum a1 = (f[i] + c1) * ComplexNum(0.5, 0);
+                    ComplexNum a2 = (f[i] - c1) * ComplexNum(0, -0.5);
+                    ComplexNum b1 = (g[i] + c2) * ComplexNum(0.5 / len, 0);
+                    ComplexNum b2 = (g[i] - c2) * ComplexNum(0, -0.5 / len);
+                    u.set(j, a1 * b1 + a2 * b2 * ComplexNum(0, 1));
+                    w.set(j, a1 * b2 + a2 * b1);
+                }
+            });
+            transform(ctx, u, len);
+            transform(ctx, w, len);
+
+            parallel_for(p_len, [&](int lo, int hi){
+                for (int i = lo; i < hi; i++){
+                    long long x = round_to_nearest(u.re[i]);
+                    long long y = round_to_nearest(w.re[i]);
+                    long long z = round_to_nearest(u.im[i]);
+                    res[i] = (x + ((y % mod) << bits) + ((z % mod) << (2 * bits))) % mod;
+                }
+            });
+        }
+
+        /***
+         * Below are the direct methods for short inputs, where setting up a transform costs more than the product itself
+         * They work on unsigned values, so the plain product is exact modulo 2^64 (which covers negative values too)
+         * With MOD, the inputs must be in [0, mod) and the results are reduced modulo mod
+         *
+         * The thresholds can be adjusted to the machine by calling tune()
+         *
+        ***/
+        int schoolbook_limit = 16, karatsuba_limit = 64, unbalanced_ratio = 4;
+
+        typedef unsigned long long ull;
+
+        /// res[0, n + m - 1) = a[0, n) * b[0, m)
+        template <bool MOD>
+        void schoolbook(const ull* a, int n, const ull* b, int m, ull* res, ull mod){
+            if (!MOD){
+                fill(res, res + n + m - 1, 0);
+                for (int i = 0; i < n; i++){
+                    for (int j = 0; j < m; j++) res[i + j] += a[i] * b[j];
+                }
+                return;
+            }
+
+            /// Every product is below 2^62, so the sum only needs to be reduced once it reaches 2^63
+            for (int k = 0; k < n + m - 1; k++){
+                ull x = 0;
+                for (int i = max(0, k - m + 1); i <= min(k, n - 1); i++){
+                    x += a[i] * b[k - i];
+                    if (x >> 63) x %= mod;
+                }
+                res[k] = x % mod;
+            }
+        }
+
+        /// res[0, 2n - 1) = a[0, n) * b[0, n), tmp needs room for 8n values
+        template <bool MOD>
+        void karatsuba(const ull* a, const ull* b, int n, ull* res, ull* tmp, ull mod){
+            if (n <= schoolbook_limit) return schoolbook<MOD>(a, n, b, n, res, mod);
+
+            int i, h = n >> 1, k = n - h;
+            ull *sa = tmp, *sb = sa + k, *mid = sb + k;
+
+            for (i = 0; i < k; i++){
+                sa[i] = a[h + i] + (i < h ? a[i] : 0);
+                sb[i] = b[h + i] + (i < h ? b[i] : 0);
+                if (MOD && sa[i] >= mod) sa[i] -= mod;
+                if (MOD && sb[i] >= mod) sb[i] -= mod;
+            }
+
+            /// (a0 + a1 x^h)(b0 + b1 x^h) = a0 b0 + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) x^h + a1 b1 x^2h
+            karatsuba<MOD>(a, b, h, res, mid + 2 * k, mod);
+            karatsuba<MOD>(a + h, b + h, k, res + 2 * h, mid + 2 * k, mod);
+            karatsuba<MOD>(sa, sb, k, mid, mid + 2 * k, mod);
+            res[2 * h - 1] = 0;
+
+            /// The middle term overlaps both a0 b0 and a1 b1, so it is finished before being added
+            for (i = 0; i < 2 * k - 1; i++){
+                mid[i] -= res[2 * h + i] + (i < 2 * h - 1 ? res[i] : 0);
+                if (MOD) mid[i] = (mid[i] + 2 * mod) % mod;
+            }
+            for (i = 0; i < 2 * k - 1; i++){
+                res[h + i] += mid[i];
+                if (MOD && res[h + i] >= mod) res[h + i] -= mod;
+            }
+        }
+
+        /***
+         * res[0, n + m - 1) = a[0, n) * b[0, m) with schoolbook or Karatsuba, depending on the shorter side
+         * The longer side is cut into chunks as long as the shorter one, so that Karatsuba always gets equal halves
+         *
+        ***/
+        template <bool MOD>
+        void direct_multiply(const ull* a, int n, const ull* b, int m, ull* res, ull mod){
+            if (n > m) swap(a, b), swap(n, m);
+            if (n <= schoolbook_limit) return schoolbook<MOD>(a, n, b, m, res, mod);
+
+            vector<ull> chunk(n), prod(2 * n), tmp(8 * n);
+            fill(res, res + n + m - 1, 0);
+            for (int i = 0; i < m; i += n){
+                int c = min(n, m - i);
+                copy(b + i, b + i + c, chunk.begin()), fill(chunk.begin() + c, chunk.end(), 0);
+                karatsuba<MOD>(a, chunk.data(), n, prod.data(), tmp.data(), mod);
+
+                for (int j = 0; j < n + c - 1; j++){
+                    res[i + j] += prod[j];
+                    if (MOD && res[i + j] >= mod) res[i + j] -= mod;
+                }
+            }
+        }
+
+        /// Whether the direct methods beat a transform for sizes n and m
+        bool use_direct(int n, int m){
+            return min(n, m) <= karatsuba_limit;
+        }
+
+        /// Product of v1[0, n) and v2[0, m) padded with zeros to p_len, modulo mod if mod is positive
+        vector<long long> direct_multiply(const vector<long long>& v1, int n, const vector<long long>& v2, int m, int p_len, int mod){
+            vector<ull> a(v1.begin(), v1.begin() + n), b(v2.begin(), v2.begin() + m), res(n + m - 1);
+            if (mod){
+                for (auto&& x: a) x = ((long long)x % mod + mod) % mod;
+                for (auto&& x: b) x = ((long long)x % mod + mod) % mod;
+                direct_multiply<true>(a.data(), n, b.data(), m, res.data(), mod);
+            }
+            else direct_multiply<false>(a.data(), n, b.data(), m, res.data(), 0);
+
+            res.resize(p_len, 0);
+            return vector<long long>(res.begin(), res.end());
+        }
 
-            int n = v1.size();
-            v1.resize(2 * n, 0), v2.resize(2 * n, 0);
-            for (int i = 0; i < n; i++) v2[i + n] = v2[i];
+        /// Whether one side is long enough compared to the other to multiply it in chunks
+        bool use_chunks(int n, int m){
+            return max(n, m) >= (long long)unbalanced_ratio * min(n, m);
         }
+
+        /***
+         * Product of v1[0, n) and v2[0, m) padded with zeros to p_len, modulo mod if mod is positive
+         * The shorter side is transformed once and the longer one is multiplied with it in chunks
+         * Each chunk only needs a transform of length 4 * min(n, m) instead of one covering the whole result
+         *
+        ***/
+        vector<long long> chunked_multiply(const vector<long long>& v1, int n, const vector<long long>& v2, int m, int p_len, int mod, int bits){
+            if (n > m) return chunked_multiply(v2, m, v1, n, p_len, mod, bits);
+
+            int i, j, len = 1 << get_bit(4 * n), chunk = len - n + 1;
+            FftContext& ctx = get_context();
+            ComplexArray op, &f = ctx.f;
+            vector<long long> res(n + m - 1, 0), prod;
+
+            if (mod) split_transform(ctx, v1.data(), n, len, mod, bits, op);
+            else real_transform(ctx, v1.data(), n, len, op);
+
+            for (i = 0; i < m; i += chunk){
+                int c = min(chunk, m - i);
+                prod.assign(n + c - 1, 0);
+
+                if (mod){
+                    split_transform(ctx, v2.data() + i, c, len, mod, bits, f);
+                    split_multiply(ctx, f, op, len, mod, bits, prod);
+                }
+                else{
+                    real_transform(ctx, v2.data() + i, c, len, f);
+                    parallel_for(len / 2 + 1, [&](int lo, int hi){
+                        for (int k = lo; k < hi; k++) f.set(k, f[k] * op[k]);
+                    });
+                    inverse_real_transform(ctx, f, len, prod);
+                }
+
+                for (j = 0; j < n + c - 1; j++){
+                    res[i + j] += prod[j];
+                    if (mod && res[i + j] >= mod) res[i + j] -= mod;
+                }
+            }
+
+            res.resize(p_len, 0);
+            return res;
+        }
+
+        /***
+         * Below are the helpers for matching over a general alphabet
+         * Every symbol of the pattern forms a class, matched against the same symbol in the text
+         * WILDCARD_CLASS pairs the wildcards of the text with every other position of the pattern
+         *
+         * The mismatches at a window are then the non wildcard positions of the pattern minus the sum over all classes
+         *
+        ***/
+        const int WILDCARD_CLASS = 256;
+
+        /// Indicator of the positions of s[0, n) in class c, reversed for the pattern side
+        vector <long long> class_indicator(const char* s, int n, int c, char wildcard, bool text){
+            vector <long long> res(n, 0);
+            for (int i = 0; i < n; i++){
+                bool wild = wildcard && s[i] == wildcard;
+                if (c == WILDCARD_CLASS) res[i] = text ? wild : !wild;
+                else res[i] = !wild && (unsigned char)s[i] == c;
+            }
+
+            if (!text) reverse(res.begin(), res.end());
+            return res;
+        }
+
+        /// Classes needed to match pattern[0, m), together with its number of non wildcard positions
+        vector <int> pattern_classes(const char* pattern, int m, char wildcard, int& count){
+            vector <int> res;
+            vector <bool> seen(WILDCARD_CLASS, false);
+
+            count = 0;
+            for (int i = 0; i < m; i++){
+                if (wildcard && pattern[i] == wildcard) continue;
+
+                count++;
+                unsigned char c = pattern[i];
+                if (!seen[c]) seen[c] = true, res.push_back(c);
+            }
+            if (wildcard) res.push_back(WILDCARD_CLASS);
+            return res;
+        }
+
+        /// sum[i] += a[i] * b[i] for the h + 1 values of a real spectrum
+        void add_product(ComplexArray& sum, const ComplexArray& a, const ComplexArray& b, int h){
+            parallel_for(h + 1, [&](int lo, int hi){
+                for (int i = lo; i < hi; i++) sum.set(i, sum[i] + a[i] * b[i]);
+            });
+        }
+
+        /// Mismatches of a pattern of length m with count non wildcard positions at every window of a text of length n
+        vector <long long> mismatches(FftContext& ctx, ComplexArray& sum, int len, int n, int m, int count){
+            vector <long long> res(n, 0);
+            inverse_real_transform(ctx, sum, len, res);
+
+            for (int i = 0; i + m <= n; i++) res[i] = count - res[i + m - 1];
+            res.resize(n - m + 1);
+            return res;
+        }
+
+        /// Distances of the pattern with the given class spectra of length len against every window of block[0, n), where n <= len
+        vector <long long> match_block(const vector <pair<int, ComplexArray>>& spectra, int len, int m, int count, char wildcard, const char* block, int n){
+            FftContext& ctx = get_context();
+            ComplexArray sum;
+            sum.resize(len / 2 + 1);
+
+            for (auto&& [c, spectrum]: spectra){
+                auto v = class_indicator(block, n, c, wildcard, true);
+                if (!count_if(v.begin(), v.end(), [](long long x){ return x != 0; })) continue;
+
+                real_transform(ctx, v.data(), n, len, ctx.f);
+                add_product(sum, ctx.f, spectrum, len / 2);
+            }
+            return mismatches(ctx, sum, len, n, m, count);
+        }
+    }
+
+    /***
+     * Frees the roots and scratch memory held by the calling thread
+     * They are allocated again if any of the methods below are called afterwards
+     *
+    ***/
+    void release(){
+        get_context().release();
+    }
+
+    /***
+     * Sets the number of threads used by the methods below, 1 by default
+     * Pass 0 to use all the hardware threads available
+     *
+     * Only large inputs are split among threads, small ones always run on the calling thread
+     * Don't change this while another thread is inside any of the methods
+     *
+    ***/
+    void set_threads(int threads){
+        num_threads = threads > 0 ? threads : max(1, (int)thread::hardware_concurrency());
+    }
+
+    /***
+     * A vector transformed ahead of time, so that it can be multiplied with many other vectors
+     * Saves one of the two forward transforms in every multiplication, reuse it whenever one side is fixed
+     *
+     * Built by prepare(), use mod = 0 for multiply() and a positive mod for mod_multiply()
+     *
+    ***/
+    struct PreparedOperand{
+        int len = 0, size = 0, mod = 0, bits = 0;
+        ComplexArray spectrum;
+    };
+
+    /***
+     * Transforms v once with the given length, which must be a power of two
+     * The prepared operand can be multiplied with any vector w such that v.size() + w.size() - 1 <= len
+     *
+    ***/
+    PreparedOperand prepare(const vector <long long>& v, int len, int mod=0, int bits=MOD_SPLIT_LIMIT){
+        assert(len >= 2 && __builtin_popcount(len) == 1 && (int)v.size() <= len);
+
+        PreparedOperand res;
+        res.len = len, res.size = v.size(), res.mod = mod, res.bits = bits;
+
+        FftContext& ctx = get_context();
+        if (mod) split_transform(ctx, v.data(), v.size(), len, mod, bits, res.spectrum);
+        else real_transform(ctx, v.data(), v.size(), len, res.spectrum);
+        return res;
+    }
+
+    /***
+     * Same as multiply(v1, v2) where op is prepare(v1, len)
+     *
+    ***/
+    vector <long long> multiply(const PreparedOperand& op, const vector <long long>& v){
+        assert(!op.mod && op.size + (int)v.size() - 1 <= op.len);
+
+        FftContext& ctx = get_context();
+        ComplexArray& f = ctx.f;
+
+        real_transform(ctx, v.data(), v.size(), op.len, f);
+        parallel_for(op.len / 2 + 1, [&](int lo, int hi){
+            for (int i = lo; i < hi; i++) f.set(i, f[i] * op.spectrum[i]);
+        });
+
+        vector <long long> res(op.size + v.size() - 1, 0);
+        inverse_real_transform(ctx, f, op.len, res);
+        return res;
+    }
+
+    /***
+     * Same as mod_multiply(v1, v2, mod) where op is prepare(v1, len, mod)
+     *
+    ***/
+    vector <long long> mod_multiply(const PreparedOperand& op, const vector <long long>& v){
+        assert(op.mod && op.size + (int)v.size() - 1 <= op.len);
+
+        FftContext& ctx = get_context();
+        ComplexArray& f = ctx.f;
+
+        split_transform(ctx, v.data(), v.size(), op.len, op.mod, op.bits, f);
+        vector <long long> res(op.size + v.size() - 1, 0);
+        split_multiply(ctx, f, op.spectrum, op.len, op.mod, op.bits, res);
+        return res;
     }
 
     /***
      * Same as multiply(v, v) but faster
      *
     ***/
-    vector <long long> square(vector <long long> v){
-        int i, len, p_len = 2 * v.size() - 1;
+    vector <long long> square(const vector <long long>& v){
+        int n = trim(v), len = 1 << get_bit(2 * n), p_len = 2 * v.size() - 1;
+        if (use_direct(n, n)) return direct_multiply(v, n, v, n, p_len, 0);
 
-        len = build(v, v);
-        for (i = 0; i < len; i++) u[i] = ComplexNum(v[i], 0);
-        transform(u, f, dp, len);
-        for (i = 0; i < len; i++) u[i] = f[i] * f[i];
-        transform(u, f, inv, len);
+        FftContext& ctx = get_context();
+        ComplexArray& f = ctx.f;
+
+        real_transform(ctx, v.data(), n, len, f);
+        parallel_for(len / 2 + 1, [&](int lo, int hi){
+            for (int i = lo; i < hi; i++) f.set(i, f[i] * f[i]);
+        });
 
         vector <long long> res(p_len, 0);
-        for (i = 0; i < min(len, p_len); i++){
-            res[i] = round_to_nearest(f[i].real / (fType)len);
-        }
+        inverse_real_transform(ctx, f, len, res);
         return res;
     }
 
@@ -176,34 +820,38 @@ namespace fft{
      *
      *     return res
      *
+     * If the shorter side is short enough, the product is computed directly with the above or with Karatsuba
+     * These results are exact as long as they fit in a long long
+     * If one side is much longer than the other, it is multiplied in chunks with the shorter one
+     *
      * Note that the values in vector shouldn't be too large in general
      * Multiplying them and adding them up may cause precision error otherwise
      * The error margin will depend on two things mostly:
      *     i) The magnitude of the initial numbers
-     *    ii) The chosen data type for complex numbers - double or long double, etc
+     *    ii) The length of the result, since errors accumulate over the levels of the transform
      *
      * In general, if the values are larger than 10^6, it'd be better to use ll_multiply instead
+     * For exact results regardless of the magnitude, use the NTT from ntt.cpp
      *
     ***/
-    vector <long long> multiply(vector <long long> v1, vector <long long> v2){
+    vector <long long> multiply(const vector <long long>& v1, const vector <long long>& v2){
+        int n = trim(v1), m = trim(v2), len = 1 << get_bit(n + m), p_len = v1.size() + v2.size() - 1;
+
+        if (use_direct(n, m)) return direct_multiply(v1, n, v2, m, p_len, 0);
+        if (use_chunks(n, m)) return chunked_multiply(v1, n, v2, m, p_len, 0, 0);
         if (is_equal(v1, v2)) return square(v1);
 
-        int i, j, len, p_len = v1.size() + v2.size() - 1;
+        FftContext& ctx = get_context();
+        ComplexArray &f = ctx.f, &g = ctx.g;
 
-        len = build(v1, v2);
-        for (i = 0; i < len; i++) u[i] = ComplexNum(v1[i], v2[i]);
-        transform(u, f, dp, len);
-
-        for (i = 0; i < len; i++){
-            j = (len - 1) & (len - i);
-            u[i] = (f[j] * f[j] - f[i].conjugate() * f[i].conjugate()) * ComplexNum(0, -0.25 / len);
-        }
-        transform(u, f, dp, len);
+        real_transform(ctx, v1.data(), n, len, f);
+        real_transform(ctx, v2.data(), m, len, g);
+        parallel_for(len / 2 + 1, [&](int lo, int hi){
+            for (int i = lo; i < hi; i++) f.set(i, f[i] * g[i]);
+        });
 
         vector <long long> res(p_len, 0);
-        for (i = 0; i < min(len, p_len); i++){
-            res[i] = round_to_nearest(f[i].real);
-        }
+        inverse_real_transform(ctx, f, len, res);
         return res;
     }
 
@@ -211,44 +859,92 @@ namespace fft{
      * Same as multiply(v1, v2), only values are calculated modulo mod
      *
     ***/
-    vector <long long> mod_multiply(vector <long long> v1, vector <long long> v2, int mod, int bits=MOD_SPLIT_LIMIT){
-        const int mask = (1 << bits) - 1;
+    vector <long long> mod_multiply(const vector <long long>& v1, const vector <long long>& v2, int mod, int bits=MOD_SPLIT_LIMIT){
+        int n = trim(v1), m = trim(v2), len = 1 << get_bit(n + m), p_len = v1.size() + v2.size() - 1;
 
-        long long x, y, z;
-        int i, j, len, p_len = v1.size() + v2.size() - 1;
+        if (use_direct(n, m)) return direct_multiply(v1, n, v2, m, p_len, mod);
+        if (use_chunks(n, m)) return chunked_multiply(v1, n, v2, m, p_len, mod, bits);
 
-        len = build(v1, v2);
-        for (i = 0; i < len; i++) v1[i] %= mod, v2[i] %= mod;
-        for (i = 0; i < len; i++) u[i] = ComplexNum(v1[i] & mask, v1[i] >> bits);
-        for (i = 0; i < len; i++) w[i] = ComplexNum(v2[i] & mask, v2[i] >> bits);
+        FftContext& ctx = get_context();
+        ComplexArray &f = ctx.f, &g = ctx.g;
 
-        transform(u, f, dp, len);
-        for (i = 0; i < len; i++) g[i] = f[i];
-        if (!is_equal(v1, v2)) transform(w, g, dp, len);
-
-        for (i = 0; i < len; i++){
-            j = (len - 1) & (len - i);
-            ComplexNum c1 = f[j].conjugate(), c2 = g[j].conjugate();
-
-            ComplexNum a1 = (f[i] + c1) * ComplexNum(0.5, 0);
-            ComplexNum a2 = (f[i] - c1) * ComplexNum(0, -0.5);
-            ComplexNum b1 = (g[i] + c2) * ComplexNum(0.5 / len, 0);
-            ComplexNum b2 = (g[i] - c2) * ComplexNum(0, -0.5 / len);
-            u[j] = a1 * b1 + a2 * b2 * ComplexNum(0, 1);
-            w[j] = a1 * b2 + a2 * b1;
+        split_transform(ctx, v1.data(), n, len, mod, bits, f);
+        if (is_equal(v1, v2)){
+            g.resize(len);
+            copy(f.re.begin(), f.re.begin() + len, g.re.begin()), copy(f.im.begin(), f.im.begin() + len, g.im.begin());
         }
-        transform(u, f, dp, len);
-        transform(w, g, dp, len);
+        else split_transform(ctx, v2.data(), m, len, mod, bits, g);
 
         vector <long long> res(p_len, 0);
-        for (i = 0; i < min(len, p_len); i++){
-            x = round_to_nearest(f[i].real);
-            y = round_to_nearest(g[i].real);
-            z = round_to_nearest(f[i].img);
-            res[i] = (x + ((y % mod) << bits) + ((z % mod) << (2 * bits))) % mod;
+        split_multiply(ctx, f, g, len, mod, bits, res);
+        return res;
+    }
+
+    /***
+     * Measures where schoolbook, Karatsuba, chunked and full transforms overtake each other on this machine
+     * and sets the thresholds used by multiply() and mod_multiply() accordingly
+     *
+     * Takes a few hundred milliseconds, call it once at startup if the defaults don't suit the machine
+     * Don't call this while another thread is inside any of the methods
+     *
+    ***/
+    void tune(){
+        auto benchmark = [](auto func){
+            int runs = 0;
+            auto start = chrono::steady_clock::now();
+            chrono::duration<double> elapsed;
+            do{
+                func(), runs++;
+                elapsed = chrono::steady_clock::now() - start;
+            } while (elapsed.count() < 2e-3);
+            return elapsed.count() / runs;
+        };
+
+        mt19937 rng(0);
+        auto random_vector = [&](int n){
+            vector <long long> v(n);
+            for (auto&& x: v) x = rng() % 1000;
+            return v;
+        };
+
+        /// Schoolbook against one level of Karatsuba on top of it
+        int n, r;
+        for (n = 8; n <= 1024; n <<= 1){
+            vector<ull> a(n), b(n), res(2 * n), tmp(8 * n);
+            for (int i = 0; i < n; i++) a[i] = rng() % 1000, b[i] = rng() % 1000;
+
+            schoolbook_limit = n;
+            double direct = benchmark([&](){ karatsuba<false>(a.data(), b.data(), n, res.data(), tmp.data(), 0); });
+            schoolbook_limit = n / 2;
+            double split = benchmark([&](){ karatsuba<false>(a.data(), b.data(), n, res.data(), tmp.data(), 0); });
+            if (split < direct) break;
         }
+        schoolbook_limit = n / 2;
 
-        return res;
+        /// Karatsuba against the transform
+        for (n = 2 * schoolbook_limit; n <= 16384; n <<= 1){
+            auto v1 = random_vector(n), v2 = random_vector(n);
+
+            karatsuba_limit = n;
+            double direct = benchmark([&](){ multiply(v1, v2); });
+            karatsuba_limit = n - 1;
+            double transform = benchmark([&](){ multiply(v1, v2); });
+            if (transform < direct) break;
+        }
+        karatsuba_limit = n / 2;
+
+        /// Chunks against a single transform, for a short side just above the Karatsuba threshold
+        n = 2 * karatsuba_limit;
+        for (r = 2; r <= 64; r <<= 1){
+            auto v1 = random_vector(n), v2 = random_vector(n * r);
+
+            unbalanced_ratio = r;
+            double chunked = benchmark([&](){ multiply(v1, v2); });
+            unbalanced_ratio = INT_MAX;
+            double single = benchmark([&](){ multiply(v1, v2); });
+            if (chunked < single) break;
+        }
+        unbalanced_ratio = r <= 64 ? r : INT_MAX;
     }
 
     /***
@@ -257,26 +953,125 @@ namespace fft{
      * Values in the vectors should not exceed the constant LL_MULTIPLY_MOD
      *
     ***/
-    vector<long long> ll_multiply(vector <long long> v1, vector <long long> v2){
+    vector<long long> ll_multiply(const vector <long long>& v1, const vector <long long>& v2){
         for (auto x: v1) assert(x >= 0 && x < LL_MULTIPLY_MOD);
         for (auto x: v2) assert(x >= 0 && x < LL_MULTIPLY_MOD);
 
-        int len = v1.size() + v2.size() - 1;
-        const long long mod1 = LL_MULTIPLY_MOD, mod2 = mod1 + 1;
+        auto res = mod_multiply(v1, v2, LL_MULTIPLY_MOD);
+        combine_ll(res, mod_multiply(v1, v2, LL_MULTIPLY_MOD + 1));
+        return res;
+    }
+
+    /***
+     * Discrete Fourier transform of v for any length n, X[k] = sum of v[j] * e^(-2 * pi * i * j * k / n)
+     * With invert, computes the inverse transform instead, including the 1 / n factor
+     *
+     * Powers of two use the transform directly, other lengths go through Bluestein's algorithm
+     * which writes the transform as a convolution of length at least 2n - 1
+     *
+    ***/
+    vector<complex<double>> dft(const vector<complex<double>>& v, bool invert=false){
+        int i, n = v.size();
+        if (n <= 1) return v;
+        int len = __builtin_popcount(n) == 1 ? n : 1 << get_bit(2 * n - 1);
+
+        FftContext& ctx = get_context();
+        ComplexArray &f = ctx.f, &g = ctx.g;
+        vector<complex<double>> res(n);
+
+        /// The inverse is the conjugate of the transform of the conjugate, scaled by 1 / n
+        const double sign = invert ? -1 : 1, scale = invert ? 1.0 / n : 1;
+
+        ctx.prepare(len);
+        f.resize(len), g.resize(len);
+        if (len == n){
+            for (i = 0; i < n; i++) f.re[i] = v[i].real(), f.im[i] = sign * v[i].imag();
+            transform(ctx, f, len, true);
+            for (i = 0; i < n; i++) res[i] = complex<double>(f.re[i] * scale, sign * f.im[i] * scale);
+            return res;
+        }
 
-        auto mod_1_res = mod_multiply(v1, v2, mod1);
-        auto mod_2_res = mod_multiply(v1, v2, mod2);
-        assert((int)mod_1_res.size() == len && (int)mod_2_res.size() == len);
+        /// jk = (j^2 + k^2 - (k - j)^2) / 2, so X[k] = c[k] * sum of (v[j] * c[j]) * conj(c[k - j]) where c[j] = e^(-pi * i * j^2 / n)
+        vector<ComplexNum> chirp(n);
+        for (i = 0; i < n; i++){
+            long double theta = -acosl(-1.0) * ((long long)i * i % (2 * n)) / n;
+            chirp[i] = ComplexNum(cosl(theta), sinl(theta));
+        }
 
-        for (int i = 0; i < len; i++){
-            mod_1_res[i] = mod_1_res[i] + (mod_2_res[i] - mod_1_res[i] + mod2) * mod1 % mod2 * mod1;
+        fill(f.re.begin(), f.re.begin() + len, 0), fill(f.im.begin(), f.im.begin() + len, 0);
+        fill(g.re.begin(), g.re.begin() + len, 0), fill(g.im.begin(), g.im.begin() + len, 0);
+        for (i = 0; i < n; i++){
+            f.set(i, ComplexNum(v[i].real(), sign * v[i].imag()) * chirp[i]);
+            g.set(i, chirp[i].conjugate());
+            if (i) g.set(len - i, chirp[i].conjugate());
         }
 
-        return mod_1_res;
+        transform(ctx, f, len), transform(ctx, g, len);
+        for (i = 0; i < len; i++) f.set(i, f[i] * g[i]);
+        transform(ctx, f, len, true);
+
+        for (i = 0; i < n; i++){
+            ComplexNum x = ComplexNum(f.re[i] / len, f.im[i] / len) * chirp[i];
+            res[i] = complex<double>(x.real * scale, sign * x.img * scale);
+        }
+        return res;
     }
 
     /***
-     * Computes the circular convolution of v1 and v2
+     * Prepares v for convolution(op, w) and mod_convolution(op, w), where w has the same size as v
+     * Use mod = 0 for convolution() and a positive mod for mod_convolution()
+     *
+    ***/
+    PreparedOperand prepare_convolution(const vector <long long>& v, int mod=0){
+        PreparedOperand res;
+        res.len = circular_length(v.size()), res.size = v.size(), res.mod = mod, res.bits = MOD_SPLIT_LIMIT;
+
+        FftContext& ctx = get_context();
+        if (mod) split_transform(ctx, v.data(), v.size(), res.len, mod, res.bits, res.spectrum);
+        else real_transform(ctx, v.data(), v.size(), res.len, res.spectrum);
+        return res;
+    }
+
+    /***
+     * Same as convolution(v1, v2) where op is prepare_convolution(v2)
+     *
+    ***/
+    vector<long long> convolution(const PreparedOperand& op, const vector <long long>& v){
+        assert(!op.mod && (int)v.size() == op.size);
+
+        FftContext& ctx = get_context();
+        ComplexArray& f = ctx.f;
+
+        real_transform(ctx, v.data(), v.size(), op.len, f);
+        parallel_for(op.len / 2 + 1, [&](int lo, int hi){
+            for (int i = lo; i < hi; i++) f.set(i, f[i] * op.spectrum[i]);
+        });
+
+        vector <long long> res(min(op.len, 2 * op.size - 1), 0);
+        inverse_real_transform(ctx, f, op.len, res);
+        fold(res, op.size, 0);
+        return res;
+    }
+
+    /***
+     * Same as mod_convolution(v1, v2, mod) where op is prepare_convolution(v2, mod)
+     *
+    ***/
+    vector<long long> mod_convolution(const PreparedOperand& op, const vector <long long>& v){
+        assert(op.mod && (int)v.size() == op.size);
+
+        FftContext& ctx = get_context();
+        ComplexArray& f = ctx.f;
+
+        split_transform(ctx, v.data(), v.size(), op.len, op.mod, op.bits, f);
+        vector <long long> res(min(op.len, 2 * op.size - 1), 0);
+        split_multiply(ctx, f, op.spectrum, op.len, op.mod, op.bits, res);
+        fold(res, op.size, op.mod);
+        return res;
+    }
+
+    /***
+     * Computes the circular convolution of v1 and v2 and returns the n values
      * The vectors must be of the same size, if not normalize and pad with zeros
      * Example to demonstrate convolution for n = 5, let A=v1, B=v2 and the result be C
      *
@@ -286,23 +1081,38 @@ namespace fft{
      * ...
      * C4 = A0B4 + A1B3 + A2B2 + A3B1 + A4B0
      *
+     * If n is a power of two, this is a single transform of length n
+     * Otherwise the linear product is computed with the smallest power of two above 2n - 1 and wrapped around
+     *
      * Note: If linear convolution is required (i.e, no wrapping around), pad with zeros accordingly
      *
      * Also read the notes on multiply()
      *
     ***/
-    vector<long long> convolution(vector <long long> v1, vector <long long> v2){
-        build_convolution(v1, v2);
-        return multiply(v1, v2);
+    vector<long long> convolution(const vector <long long>& v1, const vector <long long>& v2){
+        assert(v1.size() == v2.size());
+
+        int n = v1.size();
+        if (!use_direct(n, n)) return convolution(prepare_convolution(v2), v1);
+
+        auto res = multiply(v1, v2);
+        fold(res, n, 0);
+        return res;
     }
 
     /***
      * Same as convolution(v1, v2), only values are calculated modulo mod
      *
     ***/
-    vector<long long> mod_convolution(vector <long long> v1, vector <long long> v2, int mod){
-        build_convolution(v1, v2);
-        return mod_multiply(v1, v2, mod);
+    vector<long long> mod_convolution(const vector <long long>& v1, const vector <long long>& v2, int mod){
+        assert(v1.size() == v2.size());
+
+        int n = v1.size();
+        if (!use_direct(n, n)) return mod_convolution(prepare_convolution(v2, mod), v1);
+
+        auto res = mod_multiply(v1, v2, mod);
+        fold(res, n, mod);
+        return res;
     }
 
     /***
@@ -311,25 +1121,96 @@ namespace fft{
      * Also read the notes on ll_multiply()
      *
     ***/
-    vector<long long> ll_convolution(vector <long long> v1, vector <long long> v2){
-        build_convolution(v1, v2);
-        return ll_multiply(v1, v2);
+    vector<long long> ll_convolution(const vector <long long>& v1, const vector <long long>& v2){
+        for (auto x: v1) assert(x >= 0 && x < LL_MULTIPLY_MOD);
+        for (auto x: v2) assert(x >= 0 && x < LL_MULTIPLY_MOD);
+
+        auto res = mod_convolution(v1, v2, LL_MULTIPLY_MOD);
+        combine_ll(res, mod_convolution(v1, v2, LL_MULTIPLY_MOD + 1));
+        return res;
+    }
+
+    /***
+     * A text transformed ahead of time, so that many patterns can be matched against it
+     * The transform of every symbol is computed the first time a pattern needs it and kept afterwards
+     *
+     * Built by prepare_text(), the wildcard (if any) is shared by the text and the patterns
+     * Not safe to use from several threads at once, since the cache grows while matching
+     *
+    ***/
+    struct PreparedText{
+        int len = 0, size = 0;
+        char wildcard = 0;
+        string text;
+        map <int, ComplexArray> spectra;
+    };
+
+    /***
+     * Prepares str for hamming_distance(text, pattern) and wildcard_match(text, pattern)
+     * Use wildcard = 0 if there are no wildcards
+     *
+    ***/
+    PreparedText prepare_text(const char* str, char wildcard=0){
+        PreparedText res;
+        res.text = str, res.size = res.text.size(), res.wildcard = wildcard;
+        res.len = max(2, 1 << get_bit(res.size));
+        return res;
+    }
+
+    /***
+     * Same as hamming_distance(str, pattern, wildcard) where text is prepare_text(str, wildcard)
+     * Costs one transform per distinct symbol of the pattern plus a single inverse transform
+     *
+    ***/
+    vector<long long> hamming_distance(PreparedText& text, const char* pattern){
+        int count, n = text.size, m = strlen(pattern), h = text.len / 2;
+        if (m == 0 || m > n) return vector<long long>(m ? 0 : n + 1, 0);
+
+        FftContext& ctx = get_context();
+        ComplexArray sum;
+        sum.resize(h + 1);
+
+        for (int c: pattern_classes(pattern, m, text.wildcard, count)){
+            auto it = text.spectra.find(c);
+            if (it == text.spectra.end()){
+                auto v = class_indicator(text.text.data(), n, c, text.wildcard, true);
+                it = text.spectra.emplace(c, ComplexArray()).first;
+                if (count_if(v.begin(), v.end(), [](long long x){ return x != 0; })){
+                    real_transform(ctx, v.data(), n, text.len, it->second);
+                }
+            }
+            if (it->second.re.empty()) continue;  /// the class never occurs in the text
+
+            auto v = class_indicator(pattern, m, c, text.wildcard, false);
+            real_transform(ctx, v.data(), m, text.len, ctx.f);
+            add_product(sum, ctx.f, it->second, h);
+        }
+        return mismatches(ctx, sum, text.len, n, m, count);
     }
 
     /***
      * Hamming distance vector with every substring of length |pattern| in str
      * Hamming distance is basically the number of mismatches
      *
-     * str and pattern consists of only '1' and '0'
+     * Works for any alphabet, if wildcard is given it matches every symbol on either side
+     * Binary strings without wildcards need a single multiplication, others one transform per distinct symbol of the pattern
+     * To match many patterns against the same text, prepare it once with prepare_text()
      *
      * For example,
      *     str: "1000100101"
      *     pattern: "0110"
      *     returns: [3, 3, 1, 1, 4, 1, 2]
      *
+     *     str: "abacaba", wildcard: '?'
+     *     pattern: "a?c"
+     *     returns: [1, 1, 1, 2, 1]
+     *
     ***/
-    vector<long long> hamming_distance(const char* str, const char* pattern){
-        assert(is_binary_string(str) && is_binary_string(pattern));
+    vector<long long> hamming_distance(const char* str, const char* pattern, char wildcard=0){
+        if (wildcard || !is_binary_string(str) || !is_binary_string(pattern)){
+            auto text = prepare_text(str, wildcard);
+            return hamming_distance(text, pattern);
+        }
 
         int i, j, n = strlen(str), m = strlen(pattern);
         vector<long long> res, v1(n, 0), v2(m, 0);
@@ -344,6 +1225,93 @@ namespace fft{
         return res;
     }
 
+    /***
+     * Starting positions of every occurrence of pattern in str, where wildcard matches any symbol on either side
+     *
+     * For example,
+     *     str: "abacaba", wildcard: '?'
+     *     pattern: "a?a"
+     *     returns: [0, 2, 4]
+     *
+    ***/
+    vector<int> wildcard_match(PreparedText& text, const char* pattern){
+        vector<int> res;
+        auto dist = hamming_distance(text, pattern);
+        for (int i = 0; i < (int)dist.size(); i++){
+            if (dist[i] == 0) res.push_back(i);
+        }
+        return res;
+    }
+
+    vector<int> wildcard_match(const char* str, const char* pattern, char wildcard='?'){
+        auto text = prepare_text(str, wildcard);
+        return wildcard_match(text, pattern);
+    }
+
+    /***
+     * Hamming distances of a fixed pattern against a text which arrives in pieces and is never held in memory as a whole
+     *
+     * Uses overlap-save: the text is cut into blocks of len symbols overlapping by |pattern| - 1, and each block
+     * is matched with the transforms of the pattern computed once, so only one block is kept at a time
+     *
+     * feed() returns the distances of the windows finished so far, finish() the ones at the end of the text
+     * Together they return exactly hamming_distance(text, pattern, wildcard) in order
+     *
+    ***/
+    struct StreamMatcher{
+        int len = 0, size = 0, count = 0;
+        char wildcard = 0;
+        vector<pair<int, ComplexArray>> spectra;
+        string buffer;
+    };
+
+    /***
+     * Prepares the transforms of pattern for streaming, blocks are about four times as long as the pattern
+     *
+    ***/
+    StreamMatcher prepare_stream(const char* pattern, char wildcard=0){
+        StreamMatcher res;
+        res.size = strlen(pattern), res.wildcard = wildcard;
+        res.len = 1 << get_bit(max(4 * res.size, BLOCK_SIZE));
+        assert(res.size > 0);
+
+        FftContext& ctx = get_context();
+        for (int c: pattern_classes(pattern, res.size, wildcard, res.count)){
+            auto v = class_indicator(pattern, res.size, c, wildcard, false);
+            res.spectra.emplace_back(c, ComplexArray());
+            real_transform(ctx, v.data(), res.size, res.len, res.spectra.back().second);
+        }
+        return res;
+    }
+
+    /***
+     * Appends chunk[0, n) to the stream and returns the distances of every window completed by full blocks
+     *
+    ***/
+    vector<long long> feed(StreamMatcher& sm, const char* chunk, int n){
+        vector<long long> res;
+        sm.buffer.append(chunk, n);
+
+        int pos = 0, step = sm.len - sm.size + 1;
+        for (; pos + sm.len <= (int)sm.buffer.size(); pos += step){
+            auto v = match_block(sm.spectra, sm.len, sm.size, sm.count, sm.wildcard, sm.buffer.data() + pos, sm.len);
+            res.insert(res.end(), v.begin(), v.end());
+        }
+        sm.buffer.erase(0, pos);
+        return res;
+    }
+
+    /***
+     * Returns the distances of the windows left in the last, partial block and resets the stream
+     *
+    ***/
+    vector<long long> finish(StreamMatcher& sm){
+        vector<long long> res;
+        if ((int)sm.buffer.size() >= sm.size) res = match_block(sm.spectra, sm.len, sm.size, sm.count, sm.wildcard, sm.buffer.data(), sm.buffer.size());
+        sm.buffer.clear();
+        return res;
+    }
+
     /***
      * And convolution vector with every substring of length |pattern| in str (sharing only common 1 bits)
      *
@@ -387,21 +1355,21 @@ int main(){
     for (auto && x: v2) x = (1 << 30) - x;
     expected_result = {1152921496016912399, 55842988386341168, 1208764490845704463, 111685985362616878, 111685981067649619, 111685973551456877, 1208764475813318996, 55842987312599314, 1152921493869428752};
 
-    assert(multiply(v1, v2) != expected_result);  /// should fail because of precision, even with long double
+    assert(multiply(v1, v2) != expected_result);  /// short inputs are exact, but expected_result is only correct modulo LL_MULTIPLY_MOD * (LL_MULTIPLY_MOD + 1)
     assert(ll_multiply(v1, v2) == expected_result);
 
     v1 = {1, 2, 3, 4};
     v2 = {1, 0, 0, 2};
-    assert(convolution(v1, v2) == vector<long long>({1, 2, 3, 6, 5, 8, 11, 6, 4, 6, 8, 0, 0, 0, 0}));
+    assert(convolution(v1, v2) == vector<long long>({5, 8, 11, 6}));
 
     mod = 2;
-    assert(mod_convolution(v1, v2, mod) == vector<long long>({1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0}));
+    assert(mod_convolution(v1, v2, mod) == vector<long long>({1, 0, 1, 0}));
 
     for (auto && x: v1) x = (1 << 30) - x;
     for (auto && x: v2) x = (1 << 30) - x;
-    expected_result = {1152921502459363329, 55843003418726658, 1208764504804348163, 111686001468744198, 111686001468744197, 111686001468744200, 111686001468744203, 111686001468744198, 1208764500509380868, 55842998050017542, 1152921498164396040, 0, 0, 0, 0};
+    expected_result = {111686001468744197, 111686001468744200, 111686001468744203, 111686001468744198};
 
-    assert(convolution(v1, v2) != expected_result);  /// should fail because of precision, even with long double
+    assert(convolution(v1, v2) != expected_result);  /// same as above
     assert(ll_convolution(v1, v2) == expected_result);
 
     expected_result = {3, 3, 1, 1, 4, 1, 2};
@@ -410,5 +1378,51 @@ int main(){
     expected_result = {1, 2, 1, 1, 2};
     assert(and_convolution("0110110", "110") == expected_result);
 
+    expected_result = {1, 1, 1, 2, 1};
+    assert(hamming_distance("abacaba", "a?c", '?') == expected_result);
+    assert(wildcard_match("abacaba", "a?a") == vector<int>({0, 2, 4}));
+
+    /// One text, many patterns
+    auto text = prepare_text("mississippi");
+    assert(hamming_distance(text, "issi") == vector<long long>({3, 0, 3, 3, 0, 3, 4, 2}));
+    assert(wildcard_match(text, "ss") == vector<int>({2, 5}));
+
+    /// Text arriving in pieces
+    auto stream = prepare_stream("issi");
+    auto dist = feed(stream, "missis", 6), tail = feed(stream, "sippi", 5);
+    dist.insert(dist.end(), tail.begin(), tail.end()), tail = finish(stream);
+    dist.insert(dist.end(), tail.begin(), tail.end());
+    assert(dist == vector<long long>({3, 0, 3, 3, 0, 3, 4, 2}));
+
+    /// Transform the fixed side once and reuse it
+    auto op = prepare({5, 1, 2, 6, 9, 8}, 16);
+    assert(multiply(op, {3, 9, 0, 2}) == vector<long long>({15, 48, 15, 46, 83, 109, 84, 18, 16}));
+    assert(multiply(op, {1, 1}) == vector<long long>({5, 6, 3, 8, 15, 17, 8}));
+
+    op = prepare({5, 1, 2, 6, 9, 8}, 16, 14);
+    assert(mod_multiply(op, {3, 9, 0, 2}) == vector<long long>({1, 6, 1, 4, 13, 11, 0, 4, 2}));
+
+    op = prepare_convolution({1, 0, 0, 2});
+    assert(convolution(op, {1, 2, 3, 4}) == vector<long long>({5, 8, 11, 6}));
+
+    /// Any length works, not only powers of two
+    op = prepare_convolution({1, 0, 0, 0, 1, 0}, 7);
+    assert(mod_convolution(op, {1, 2, 3, 4, 5, 6}) == vector<long long>({4, 6, 1, 3, 6, 1}));
+
+    assert(dft({}).empty() && dft({complex<double>(2, -1)}, true)[0] == complex<double>(2, -1));
+    auto spectrum = dft({1, 2, 3});
+    assert(abs(spectrum[0] - complex<double>(6, 0)) < 1e-9 && abs(spectrum[1] - complex<double>(-1.5, sqrt(3) / 2)) < 1e-9);
+    assert(abs(dft(spectrum, true)[2] - complex<double>(3, 0)) < 1e-9);
+
+    set_threads(4);  /// large inputs are now split among 4 threads
+    v1 = vector<long long>(1 << 18, 1), v2 = vector<long long>(1 << 18, 2);
+    auto res = multiply(v1, v2);
+    for (int i = 0; i < (int)res.size(); i++) assert(res[i] == 2 * min(i + 1, (int)res.size() - i));
+
+    tune();  /// adjusts the thresholds between schoolbook, Karatsuba and the transform to this machine
+    v1 = vector<long long>(1000, 1), v2 = vector<long long>(20, 3);
+    res = multiply(v1, v2);
+    for (int i = 0; i < (int)res.size(); i++) assert(res[i] == 3 * min({i + 1, (int)res.size() - i, 20}));
+
     return 0;
 }
@@ -1,103 +1,1017 @@
 /***
- * Simple open addressing hash table with linear probing
- * Every operation is O(1) with very light constant factor
+ * Open addressing hash table with linear probing
+ * Every operation is O(1) expected with very light constant factor
  *
- * Uses a variation SM Hash for choosing the buckets randomly
+ * The table grows by doubling once it is 3/4 full, so the number of entries need not be known up front
+ * reserve(n) (or passing n to the constructor) allocates room for n entries at once so no rehashing happens later
+ *
+ * Buckets are picked with multiply-shift hashing using a random odd salt per table
  * Otherwise it'd be easy to generate counter cases leading to O(n) per operation
- * Need to specify the maximum number of entries to be inserted on construction
- * This is because of better performance as keys are not redistributed
  *
- * For maximal performance, declare once and clear for re-use
+ * Erasing uses backward shift deletion, entries after the erased one are moved back into the hole
+ * So there are no tombstones, and lookups of keys inserted after a collision never stop early
+ *
+ * Keys are hashed with Hasher<TKey> by default, which supports integral types, pairs, strings and anything std::hash does
+ * For other keys, such as structs, pass a hasher returning a 64-bit value as the third template argument
+ * hash_combine() can be used to build one from the hashes of the members, see the example in main
+ * Keys also need operator==, keys and values need to be default constructible
+ *
+ * For maximal performance, declare once and clear for re-use, clear() is O(1)
+ * With many keys at hand, get_many and add_many hash a few keys ahead and prefetch their slots, so that the cache misses
+ * of several lookups overlap, which helps once the table is larger than the cache
+ *
+ * Default values for keys is TValue(), like STL map
+ *
+ * for (auto [key, value]: map) visits every entry, in no particular order, value can be modified through it
+ * Iterating takes time proportional to the capacity, not the size, and is invalidated by any insertion or erase
  *
- * Default values for keys is 0, like STL map
+ * save(path) writes the table to a flat file with the same layout it has in memory, when keys and values are trivially
+ * copyable or pairs of such, load(path) reads it back without placing any key again
+ * HashMapView maps such a file read-only instead, so lookups can start right away however big the table is
  *
 ***/
 
 #include <bits/stdc++.h>
 
+#ifdef __SSE2__
+    #include <emmintrin.h>
+    #define HASHMAP_SSE2
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define HASHMAP_MMAP
+#endif
+
 using namespace std;
 
-template <typename TKey, typename TValue>
+/// Random seed of the hashers, so that hashes of pairs and strings can not be forced to collide
+const uint64_t HASH_SEED = mt19937_64(chrono::steady_clock::now().time_since_epoch().count())() | 1;
+
+inline uint64_t hash_mix(uint64_t x){
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t hash_combine(uint64_t h, uint64_t x){
+    return hash_mix(h + HASH_SEED) ^ x;
+}
+
+/// Falls back to std::hash, for floating point types or types the user specialized std::hash for
+template <typename T, typename=void>
+struct Hasher{
+    uint64_t operator()(const T& x) const{
+        return hash<T>()(x);
+    }
+};
+
+/// Integers are used as they are, multiply-shift in the table mixes them
+template <typename T>
+struct Hasher<T, typename enable_if<is_integral<T>::value && sizeof(T) <= 8>::type>{
+    uint64_t operator()(T x) const{
+        return x;
+    }
+};
+
+#ifdef __SIZEOF_INT128__
+template <>
+struct Hasher<__int128>{
+    uint64_t operator()(__int128 x) const{
+        return hash_combine(x >> 64, (uint64_t)x);
+    }
+};
+
+template <>
+struct Hasher<unsigned __int128>{
+    uint64_t operator()(unsigned __int128 x) const{
+        return hash_combine(x >> 64, (uint64_t)x);
+    }
+};
+#endif
+
+template <typename T1, typename T2>
+struct Hasher<pair<T1, T2>>{
+    uint64_t operator()(const pair<T1, T2>& x) const{
+        return hash_combine(Hasher<T1>()(x.first), Hasher<T2>()(x.second));
+    }
+};
+
+/// Mixes the string in 8 bytes at a time, starting from the random seed
+template <>
+struct Hasher<string>{
+    uint64_t operator()(const string& s) const{
+        uint64_t h = HASH_SEED ^ s.size(), w;
+        size_t i = 0;
+
+        for ( ; i + 8 <= s.size(); i += 8){
+            memcpy(&w, s.data() + i, 8);
+            h = hash_mix(h ^ w);
+        }
+        if (i < s.size()){
+            w = 0;
+            memcpy(&w, s.data() + i, s.size() - i);
+            h = hash_mix(h ^ w);
+        }
+        return h;
+    }
+};
+
+/// Types saved as raw bytes, pairs count too as they are only not trivially copyable because of their assignment operator
+template <typename T>
+struct is_raw_copyable: is_trivially_copyable<T>{};
+
+template <typename T1, typename T2>
+struct is_raw_copyable<pair<T1, T2>>: integral_constant<bool, is_raw_copyable<T1>::value && is_raw_copyable<T2>::value>{};
+
+/// Header of the files written by HashMap::save, followed by a byte per slot telling if it is used, then the keys,
+/// then the values, each of them starting at a multiple of 64 bytes
+struct HashMapHeader{
+    static const uint64_t MAGIC = 0x3150414d48534148ULL;   /// "HASHMAP1"
+    static const uint64_t USED_OFFSET = 64;
+
+    uint64_t magic, key_size, value_size, salt, bits, size;
+
+    static uint64_t align(uint64_t x){
+        return (x + 63) & ~63ULL;
+    }
+
+    uint64_t keys_offset() const{
+        return align(USED_OFFSET + (1ULL << bits));
+    }
+
+    uint64_t values_offset() const{
+        return align(keys_offset() + (key_size << bits));
+    }
+
+    uint64_t file_size() const{
+        return values_offset() + (value_size << bits);
+    }
+
+    bool matches(uint64_t key_size, uint64_t value_size) const{
+        return magic == MAGIC && this->key_size == key_size && this->value_size == value_size && bits >= 1 && bits <= 30;
+    }
+
+    /// Writes zeros up to offset, given that pos bytes are written so far
+    static bool pad(FILE* out, uint64_t pos, uint64_t offset){
+        static const char zeros[64] = {};
+        return fwrite(zeros, 1, offset - pos, out) == offset - pos;
+    }
+};
+
+template <typename TKey, typename TValue, typename THash = Hasher<TKey>>
 class HashMap{
     private:
         const uint64_t seed = chrono::system_clock::now().time_since_epoch().count();
+        uint64_t salt = mt19937_64(seed)() | 1;
 
-        uint64_t rnd = mt19937_64(seed)();
-        const uint64_t salt = (rnd & 1) ? rnd : rnd--;
-
-        int cur_id, _size, hash_mod;
+        /// 2^bits buckets, slot i holds an entry if id[i] == cur_id
+        int cur_id, _size, bits, mask;
 
         vector<int> id;
         vector<TKey> keys;
         vector<TValue> values;
+        THash hasher;
+
+        /// Keys looked up ahead of the current one in get_many and add_many, a power of two
+        static constexpr int PREFETCH_DISTANCE = 16;
 
-        inline int get_pos(TKey x){
-            int i = ((x ^ (x >> 33)) * salt) & hash_mod;
-            while (id[i] == cur_id && keys[i] != x) i++;
+        inline uint64_t hash(const TKey& x) const{
+            return hasher(x) * salt;
+        }
+
+        inline int home(const TKey& x) const{
+            return hash(x) >> (64 - bits);
+        }
+
+        /// Slot holding x, or the empty slot where x would be inserted, given its hash h
+        inline int get_pos(const TKey& x, uint64_t h) const{
+            int i = h >> (64 - bits);
+            while (id[i] == cur_id && !(keys[i] == x)) i = (i + 1) & mask;
             return i;
         }
 
-    public:
-        HashMap(int max_len){
-            int buffer = 4 * sqrt(max_len);
-            int max_bits = 32 - __builtin_clz(max_len);
-            hash_mod = (1 << (max_bits + 1)) - 1;
+        inline int get_pos(const TKey& x) const{
+            return get_pos(x, hash(x));
+        }
+
+        /// Calls f(i, hash of xs[i]) for every i < n in order, while the slots of the key PREFETCH_DISTANCE later are fetched
+        /// Hashes are kept rather than slots, as the table may grow in between
+        template <typename F>
+        inline void batched(const TKey* xs, int n, F f) const{
+            uint64_t ahead[PREFETCH_DISTANCE];
+            for (int i = 0; i < n + PREFETCH_DISTANCE; i++){
+                uint64_t& h = ahead[i & (PREFETCH_DISTANCE - 1)];
+                if (i >= PREFETCH_DISTANCE) f(i - PREFETCH_DISTANCE, h);
 
-            _size = 0, cur_id = 1;
-            id.resize(hash_mod + buffer, 0);
-            keys.resize(hash_mod + buffer, 0);
-            values.resize(hash_mod + buffer, 0);
+                if (i < n){
+                    h = hash(xs[i]);
+                    int j = h >> (64 - bits);
+                    /// Not in a helper function, GCC treats prefetching as free of side effects and drops calls to one
+                    __builtin_prefetch(&id[j]), __builtin_prefetch(&keys[j]), __builtin_prefetch(&values[j]);
+                }
+            }
         }
 
-        void set(TKey x, TValue v){
-            int i = get_pos(x);
-            if (id[i] == cur_id){
-                values[i] = v;
-                return;
+        void rehash(int new_bits){
+            vector<int> old_id(1 << new_bits, 0);
+            vector<TKey> old_keys(1 << new_bits);
+            vector<TValue> old_values(1 << new_bits);
+
+            swap(id, old_id), swap(keys, old_keys), swap(values, old_values);
+            int old_id_value = cur_id;
+            bits = new_bits, mask = (1 << bits) - 1, cur_id = 1;
+
+            for (int i = 0; i < (int)old_id.size(); i++){
+                if (old_id[i] == old_id_value){
+                    int j = get_pos(old_keys[i]);
+                    keys[j] = move(old_keys[i]), values[j] = move(old_values[i]), id[j] = cur_id;
+                }
+            }
+        }
+
+        /// Slot of x, inserting it with the default value first if it is not there
+        inline int insert_pos(const TKey& x, uint64_t h){
+            int i = get_pos(x, h);
+            if (id[i] != cur_id){
+                if ((_size + 1) * 4LL > 3LL * (mask + 1)){
+                    rehash(bits + 1);
+                    i = get_pos(x, h);
+                }
+
+                keys[i] = x, values[i] = TValue(), id[i] = cur_id;
+                _size++;
             }
+            return i;
+        }
 
-            keys[i] = x, values[i] = v, id[i] = cur_id;
-            _size++;
+        inline int insert_pos(const TKey& x){
+            return insert_pos(x, hash(x));
         }
 
-        void add(TKey x, TValue v){
-            int i = get_pos(x);
-            if (id[i] == cur_id){
-                values[i] += v;
-                return;
+        /// Whether the first few entries are found where they are, which fails for a table saved by another process
+        /// if the hasher depends on HASH_SEED
+        bool hashes_match() const{
+            for (int i = 0, checked = 0; i <= mask && checked < 64; i++){
+                if (id[i] == cur_id){
+                    if (get_pos(keys[i]) != i) return false;
+                    checked++;
+                }
             }
+            return true;
+        }
+
+    public:
+        template <bool is_const>
+        class Iterator{
+            private:
+                using Map = typename conditional<is_const, const HashMap, HashMap>::type;
+                using Value = typename conditional<is_const, const TValue, TValue>::type;
+
+                Map* map;
+                int i;
+
+                void skip(){
+                    while (i <= map->mask && map->id[i] != map->cur_id) i++;
+                }
+
+            public:
+                Iterator(Map* map, int i): map(map), i(i){
+                    skip();
+                }
+
+                pair<const TKey&, Value&> operator*() const{
+                    return {map->keys[i], map->values[i]};
+                }
+
+                Iterator& operator++(){
+                    i++, skip();
+                    return *this;
+                }
+
+                bool operator==(const Iterator& other) const{
+                    return i == other.i;
+                }
+
+                bool operator!=(const Iterator& other) const{
+                    return i != other.i;
+                }
+        };
 
-            keys[i] = x, values[i] = v, id[i] = cur_id;
-            _size++;
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+
+        HashMap(int max_len = 0, const THash& hasher = THash()): cur_id(1), _size(0), bits(0), mask(0), id(1, 0), keys(1), values(1), hasher(hasher){
+            reserve(max_len);
+        }
+
+        /// Makes room for n entries in total, so inserting up to n entries never rehashes
+        void reserve(int n){
+            int b = max(bits, 3);
+            while (4LL * n > 3LL << b) b++;
+            if (b != bits) rehash(b);
+        }
+
+        void set(const TKey& x, const TValue& v){
+            values[insert_pos(x)] = v;
         }
 
-        TValue get(TKey x){
+        void add(const TKey& x, const TValue& v){
+            values[insert_pos(x)] += v;
+        }
+
+        TValue get(const TKey& x) const{
             int i = get_pos(x);
-            return id[i] == cur_id ? values[i] : 0;
+            return id[i] == cur_id ? values[i] : TValue();
         }
 
-        void erase(TKey x){
+        void erase(const TKey& x){
             int i = get_pos(x);
+            if (id[i] != cur_id) return;
 
-            if (id[i] == cur_id){
-                keys[i] = 0, values[i] = 0, id[i] = 0;
-                _size--;
+            /// Moves back every following entry of the cluster which is allowed to sit in the hole at i
+            for (int j = (i + 1) & mask; id[j] == cur_id; j = (j + 1) & mask){
+                if (((j - home(keys[j])) & mask) >= ((j - i) & mask)){
+                    keys[i] = move(keys[j]), values[i] = move(values[j]);
+                    i = j;
+                }
             }
+
+            keys[i] = TKey(), values[i] = TValue(), id[i] = 0;
+            _size--;
         }
 
-        bool contains(TKey x){
+        bool contains(const TKey& x) const{
             int i = get_pos(x);
             return id[i] == cur_id;
         }
 
+        /// out[i] = get(xs[i]) for every i < n, with the memory accesses of several lookups overlapped
+        /// Worth it once the table does not fit in cache
+        void get_many(const TKey* xs, int n, TValue* out) const{
+            batched(xs, n, [&](int i, uint64_t h){
+                int j = get_pos(xs[i], h);
+                out[i] = id[j] == cur_id ? values[j] : TValue();
+            });
+        }
+
+        void get_many(const vector<TKey>& xs, vector<TValue>& out) const{
+            out.resize(xs.size());
+            get_many(xs.data(), xs.size(), out.data());
+        }
+
+        /// add(xs[i], vs[i]) for every i < n in order, with the memory accesses of several updates overlapped
+        void add_many(const TKey* xs, const TValue* vs, int n){
+            batched(xs, n, [&](int i, uint64_t h){
+                values[insert_pos(xs[i], h)] += vs[i];
+            });
+        }
+
+        void add_many(const vector<TKey>& xs, const vector<TValue>& vs){
+            assert(xs.size() == vs.size());
+            add_many(xs.data(), vs.data(), xs.size());
+        }
+
         void clear(){
             _size = 0;
             cur_id++;
         }
 
-        int size(){
+        int size() const{
             return _size;
         }
+
+        /// Calls f(key, value) for every entry, in no particular order
+        template <typename F>
+        void for_each(F f) const{
+            for (int i = 0; i <= mask; i++){
+                if (id[i] == cur_id) f(keys[i], values[i]);
+            }
+        }
+
+        iterator begin(){
+            return iterator(this, 0);
+        }
+
+        iterator end(){
+            return iterator(this, mask + 1);
+        }
+
+        const_iterator begin() const{
+            return const_iterator(this, 0);
+        }
+
+        const_iterator end() const{
+            return const_iterator(this, mask + 1);
+        }
+
+        /// Writes the table to path, see HashMapHeader for the layout, returns false on failure
+        bool save(const char* path) const{
+            static_assert(is_raw_copyable<TKey>::value && is_raw_copyable<TValue>::value, "Keys and values are saved as raw bytes");
+
+            FILE* out = fopen(path, "wb");
+            if (!out) return false;
+
+            HashMapHeader header = {HashMapHeader::MAGIC, sizeof(TKey), sizeof(TValue), salt, (uint64_t)bits, (uint64_t)_size};
+            uint64_t cap = mask + 1ULL;
+            bool ok = fwrite(&header, sizeof(header), 1, out) == 1 && HashMapHeader::pad(out, sizeof(header), HashMapHeader::USED_OFFSET);
+
+            vector<uint8_t> used(1 << 16);
+            for (uint64_t i = 0; i < cap && ok; i += used.size()){
+                uint64_t len = min<uint64_t>(used.size(), cap - i);
+                for (uint64_t j = 0; j < len; j++) used[j] = id[i + j] == cur_id;
+                ok = fwrite(used.data(), 1, len, out) == len;
+            }
+
+            ok = ok && HashMapHeader::pad(out, HashMapHeader::USED_OFFSET + cap, header.keys_offset());
+            ok = ok && fwrite(keys.data(), sizeof(TKey), cap, out) == cap;
+            ok = ok && HashMapHeader::pad(out, header.keys_offset() + sizeof(TKey) * cap, header.values_offset());
+            ok = ok && fwrite(values.data(), sizeof(TValue), cap, out) == cap;
+
+            return fclose(out) == 0 && ok;
+        }
+
+        /// Replaces the table with the one saved to path, returns false if the file is missing or was saved for other types
+        /// Entries are read as they are, and only placed again if the keys hash differently in this process
+        bool load(const char* path){
+            static_assert(is_raw_copyable<TKey>::value && is_raw_copyable<TValue>::value, "Keys and values are saved as raw bytes");
+
+            FILE* in = fopen(path, "rb");
+            if (!in) return false;
+
+            HashMapHeader header;
+            bool ok = fread(&header, sizeof(header), 1, in) == 1 && header.matches(sizeof(TKey), sizeof(TValue));
+            if (ok){
+                uint64_t cap = 1ULL << header.bits;
+                vector<int> new_id(cap);
+                vector<TKey> new_keys(cap);
+                vector<TValue> new_values(cap);
+
+                vector<uint8_t> used(1 << 16);
+                ok = fseek(in, HashMapHeader::USED_OFFSET, SEEK_SET) == 0;
+                for (uint64_t i = 0; i < cap && ok; i += used.size()){
+                    uint64_t len = min<uint64_t>(used.size(), cap - i);
+                    ok = fread(used.data(), 1, len, in) == len;
+                    for (uint64_t j = 0; j < len; j++) new_id[i + j] = used[j];
+                }
+
+                ok = ok && fseek(in, header.keys_offset(), SEEK_SET) == 0 && fread(new_keys.data(), sizeof(TKey), cap, in) == cap;
+                ok = ok && fseek(in, header.values_offset(), SEEK_SET) == 0 && fread(new_values.data(), sizeof(TValue), cap, in) == cap;
+
+                if (ok){
+                    swap(id, new_id), swap(keys, new_keys), swap(values, new_values);
+                    salt = header.salt, cur_id = 1, _size = header.size;
+                    bits = header.bits, mask = (1 << bits) - 1;
+                }
+            }
+
+            fclose(in);
+            if (ok && !hashes_match()) rehash(bits);
+            return ok;
+        }
+};
+
+/***
+ *
+ * Read-only HashMap over a file written by HashMap::save, mapped into memory rather than read
+ * So loading takes the same time whatever the size, pages are read from disk as lookups first touch them,
+ * and processes mapping the same file share them
+ *
+ * get, contains, size and iteration work as in HashMap, load(path) returns false if the file is missing, was saved for
+ * other types, or if the keys hash differently in this process, as keys hashed with HASH_SEED do
+ *
+***/
+template <typename TKey, typename TValue, typename THash = Hasher<TKey>>
+class HashMapView{
+    private:
+        shared_ptr<const char> data;
+        uint64_t salt;
+        int _size, bits, mask;
+
+        const uint8_t* used;
+        const TKey* keys;
+        const TValue* values;
+        THash hasher;
+
+        /// Slot holding x, or the empty slot ending its probe sequence
+        inline int get_pos(const TKey& x) const{
+            int i = (hasher(x) * salt) >> (64 - bits);
+            while (used[i] && !(keys[i] == x)) i = (i + 1) & mask;
+            return i;
+        }
+
+        bool hashes_match() const{
+            for (int i = 0, checked = 0; i <= mask && checked < 64; i++){
+                if (used[i]){
+                    if (get_pos(keys[i]) != i) return false;
+                    checked++;
+                }
+            }
+            return true;
+        }
+
+    public:
+        class iterator{
+            private:
+                const HashMapView* view;
+                int i;
+
+                void skip(){
+                    while (i <= view->mask && !view->used[i]) i++;
+                }
+
+            public:
+                iterator(const HashMapView* view, int i): view(view), i(i){
+                    skip();
+                }
+
+                pair<const TKey&, const TValue&> operator*() const{
+                    return {view->keys[i], view->values[i]};
+                }
+
+                iterator& operator++(){
+                    i++, skip();
+                    return *this;
+                }
+
+                bool operator==(const iterator& other) const{
+                    return i == other.i;
+                }
+
+                bool operator!=(const iterator& other) const{
+                    return i != other.i;
+                }
+        };
+
+        HashMapView(const THash& hasher = THash()): salt(1), _size(0), bits(0), mask(0), used(nullptr), keys(nullptr), values(nullptr), hasher(hasher){}
+
+        /// Maps the table saved to path, the view stays valid until the next load or its destruction
+        bool load(const char* path){
+            static_assert(is_raw_copyable<TKey>::value && is_raw_copyable<TValue>::value, "Keys and values are saved as raw bytes");
+
+#ifdef HASHMAP_MMAP
+            int fd = open(path, O_RDONLY);
+            if (fd < 0) return false;
+
+            struct stat st;
+            void* addr = MAP_FAILED;
+            uint64_t len = 0;
+            if (fstat(fd, &st) == 0 && (uint64_t)st.st_size >= HashMapHeader::USED_OFFSET){
+                len = st.st_size;
+                addr = mmap(0, len, PROT_READ, MAP_SHARED, fd, 0);
+            }
+            close(fd);
+            if (addr == MAP_FAILED) return false;
+
+            /// Lookups touch one page each, reading ahead around them only slows down the first ones
+            madvise(addr, len, MADV_RANDOM);
+            shared_ptr<const char> file((const char*)addr, [len](const char* ptr){ munmap((void*)ptr, len); });
+#else
+            FILE* in = fopen(path, "rb");
+            if (!in) return false;
+
+            uint64_t len = fseek(in, 0, SEEK_END) == 0 ? ftell(in) : 0;
+            bool ok = len >= HashMapHeader::USED_OFFSET && fseek(in, 0, SEEK_SET) == 0;
+
+            char* buffer = ok ? new char[len] : nullptr;
+            shared_ptr<const char> file(buffer, default_delete<char[]>());
+            ok = ok && fread(buffer, 1, len, in) == len;
+            fclose(in);
+            if (!ok) return false;
+#endif
+
+            const HashMapHeader& header = *(const HashMapHeader*)file.get();
+            if (!header.matches(sizeof(TKey), sizeof(TValue)) || header.file_size() != len) return false;
+
+            HashMapView view(hasher);
+            view.data = file, view.salt = header.salt, view._size = header.size;
+            view.bits = header.bits, view.mask = (1 << view.bits) - 1;
+            view.used = (const uint8_t*)(file.get() + HashMapHeader::USED_OFFSET);
+            view.keys = (const TKey*)(file.get() + header.keys_offset());
+            view.values = (const TValue*)(file.get() + header.values_offset());
+
+            if (!view.hashes_match()) return false;
+            *this = view;
+            return true;
+        }
+
+        TValue get(const TKey& x) const{
+            if (!_size) return TValue();
+            int i = get_pos(x);
+            return used[i] ? values[i] : TValue();
+        }
+
+        bool contains(const TKey& x) const{
+            return _size && used[get_pos(x)];
+        }
+
+        int size() const{
+            return _size;
+        }
+
+        iterator begin() const{
+            return iterator(this, _size ? 0 : mask + 1);
+        }
+
+        iterator end() const{
+            return iterator(this, mask + 1);
+        }
+};
+
+/***
+ *
+ * Swiss table (https://abseil.io/about/design/swisstables) with the same interface as HashMap
+ *
+ * Slots come in groups of 16, and every group has 16 control bytes holding 7 bits of the hash of each key in it
+ * A probe compares the control bytes of a whole group at once with SSE2, and only compares the keys whose 7 bits match
+ * The control bytes and the key value pairs of a group are stored together, so a hit usually touches two cache lines
+ * Groups are probed quadratically and the table grows once it is 7/8 full, it stays fast at such high loads
+ *
+ * Like F14 (https://engineering.fb.com/2019/04/25/developer-tools/f14/), every group counts the keys which were
+ * inserted past it because it was full, and a lookup stops at the first group where that count is 0
+ * So most misses only look at one group even when it is full, and erasing just empties the slot, there are no tombstones
+ *
+ * Every group also stores the cur_id it was last written with and groups with older ones count as empty, so clear() is O(1)
+ *
+***/
+template <typename TKey, typename TValue, typename THash = Hasher<TKey>>
+class SwissHashMap{
+    private:
+        static const int GROUP_SIZE = 16;
+        static const uint8_t EMPTY = 0x80;
+
+        /// Each key is stored next to its value, so a hit reads the control bytes and then a single slot
+        struct Slot{
+            TKey key;
+            TValue value;
+        };
+
+        struct Group{
+            uint8_t ctrl[GROUP_SIZE];
+            int id, overflow;
+            Slot slots[GROUP_SIZE];
+        };
+
+        const uint64_t seed = chrono::system_clock::now().time_since_epoch().count();
+        const uint64_t salt = mt19937_64(seed)() | 1;
+
+        /// 2^bits groups
+        int cur_id, _size, bits, mask;
+
+        vector<Group> groups;
+        THash hasher;
+
+        /// Bitmask of the slots whose control byte is c
+        static inline int match(const uint8_t* ctrl, uint8_t c){
+#ifdef HASHMAP_SSE2
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)ctrl), _mm_set1_epi8(c)));
+#else
+            int res = 0;
+            for (int i = 0; i < GROUP_SIZE; i++) res |= (ctrl[i] == c) << i;
+            return res;
+#endif
+        }
+
+        inline uint64_t hash_of(const TKey& x) const{
+            return hasher(x) * salt;
+        }
+
+        /// The group is picked by the top bits of the hash, and the 7 bits below them go in the control byte
+        inline int home(uint64_t h) const{
+            return h >> (64 - bits);
+        }
+
+        inline uint8_t tag_of(uint64_t h) const{
+            return (h >> (57 - bits)) & 127;
+        }
+
+        int capacity() const{
+            return GROUP_SIZE << bits;
+        }
+
+        inline Slot& slot(int pos){
+            return groups[pos / GROUP_SIZE].slots[pos % GROUP_SIZE];
+        }
+
+        inline const Slot& slot(int pos) const{
+            return groups[pos / GROUP_SIZE].slots[pos % GROUP_SIZE];
+        }
+
+        /// Slot of x as group * GROUP_SIZE + index, or -1 if it is not there
+        /// The triangular probe sequence visits every group once in its first mask + 1 steps, where the search stops
+        /// even if every group has overflowed, as happens after erasing and refilling
+        inline int find(const TKey& x, uint64_t h) const{
+            uint8_t tag = tag_of(h);
+            for (int g = home(h), step = 0; step <= mask; g = (g + ++step) & mask){
+                const Group& group = groups[g];
+                if (group.id != cur_id) return -1;
+
+                for (int m = match(group.ctrl, tag); m; m &= m - 1){
+                    int i = __builtin_ctz(m);
+                    if (group.slots[i].key == x) return g * GROUP_SIZE + i;
+                }
+                if (!group.overflow) return -1;
+            }
+            return -1;
+        }
+
+        /// Takes the first empty slot on the probe sequence of h, counting the overflow in the full groups before it
+        inline int place(uint64_t h){
+            for (int g = home(h), step = 0; ; g = (g + ++step) & mask){
+                Group& group = groups[g];
+                if (group.id != cur_id){
+                    memset(group.ctrl, EMPTY, GROUP_SIZE);
+                    group.id = cur_id, group.overflow = 0;
+                }
+
+                int m = match(group.ctrl, EMPTY);
+                if (m){
+                    int i = __builtin_ctz(m);
+                    group.ctrl[i] = tag_of(h);
+                    _size++;
+                    return g * GROUP_SIZE + i;
+                }
+                group.overflow++;
+            }
+        }
+
+        void rehash(int new_bits){
+            vector<Group> old(1 << new_bits);
+            swap(groups, old);
+
+            int old_id = cur_id;
+            bits = new_bits, mask = (1 << bits) - 1, cur_id = 1, _size = 0;
+
+            for (auto&& group: old){
+                if (group.id != old_id) continue;
+                for (int m = ~match(group.ctrl, EMPTY) & 0xFFFF; m; m &= m - 1){
+                    int i = __builtin_ctz(m);
+                    slot(place(hash_of(group.slots[i].key))) = move(group.slots[i]);
+                }
+            }
+        }
+
+        /// Slot of x, inserting it with the default value first if it is not there
+        inline int insert_pos(const TKey& x){
+            uint64_t h = hash_of(x);
+            int pos = find(x, h);
+            if (pos >= 0) return pos;
+
+            if (_size >= capacity() / 8 * 7) rehash(bits + 1);
+            pos = place(h);
+            slot(pos) = {x, TValue()};
+            return pos;
+        }
+
+    public:
+        SwissHashMap(int max_len = 0, const THash& hasher = THash()): cur_id(1), _size(0), bits(0), hasher(hasher){
+            rehash(1);
+            reserve(max_len);
+        }
+
+        /// Makes room for n entries in total, so inserting up to n entries never rehashes
+        void reserve(int n){
+            int b = bits;
+            while ((GROUP_SIZE << b) / 8 * 7 < n) b++;
+            if (b != bits) rehash(b);
+        }
+
+        void set(const TKey& x, const TValue& v){
+            slot(insert_pos(x)).value = v;
+        }
+
+        void add(const TKey& x, const TValue& v){
+            slot(insert_pos(x)).value += v;
+        }
+
+        TValue get(const TKey& x) const{
+            int pos = find(x, hash_of(x));
+            return pos >= 0 ? slot(pos).value : TValue();
+        }
+
+        void erase(const TKey& x){
+            uint64_t h = hash_of(x);
+            int pos = find(x, h);
+            if (pos < 0) return;
+
+            /// The groups probed before the one holding x no longer overflow because of it
+            for (int g = home(h), step = 0; g != pos / GROUP_SIZE; g = (g + ++step) & mask) groups[g].overflow--;
+
+            groups[pos / GROUP_SIZE].ctrl[pos % GROUP_SIZE] = EMPTY;
+            slot(pos) = {TKey(), TValue()};
+            _size--;
+        }
+
+        bool contains(const TKey& x) const{
+            return find(x, hash_of(x)) >= 0;
+        }
+
+        void clear(){
+            _size = 0;
+            cur_id++;
+        }
+
+        int size() const{
+            return _size;
+        }
+
+        /// Calls f(key, value) for every entry, in no particular order
+        template <typename F>
+        void for_each(F f) const{
+            for (auto&& group: groups){
+                if (group.id != cur_id) continue;
+                for (int m = ~match(group.ctrl, EMPTY) & 0xFFFF; m; m &= m - 1){
+                    const Slot& s = group.slots[__builtin_ctz(m)];
+                    f(s.key, s.value);
+                }
+            }
+        }
+};
+
+/***
+ *
+ * HashMap split into shards by the hash of the key, each with its own lock, for use from several threads at once
+ * Every operation only locks the shard of its key, so threads working on different keys rarely wait for each other
+ * set, add, get, erase and contains are atomic
+ *
+ * For heavy aggregation, give each thread a ConcurrentHashMap::Buffer, which collects adds per shard and applies
+ * BUFFER_SIZE of them under a single lock, skipping shards that are locked by someone else until their batch gets large
+ * The buffer is flushed on destruction or with flush(), only then are its adds visible in the map
+ *
+ * for_each(f, threads) calls f(key, value) for every entry, on several threads which each take a range of shards
+ * merge(other, threads) adds every entry of other, shard by shard in parallel
+ * Shards are picked from a hash with the same random seed in every map, so equal keys are in equal shards of two maps
+ *
+ * Compile with -pthread on older toolchains
+ *
+***/
+template <typename TKey, typename TValue, typename THash = Hasher<TKey>>
+class ConcurrentHashMap{
+    private:
+        static const int BUFFER_SIZE = 64;
+
+        /// Aligned so that the locks of neighbouring shards are not on the same cache line
+        struct alignas(64) Shard{
+            mutex lock;
+            HashMap<TKey, TValue, THash> map;
+        };
+
+        int bits;
+        vector<Shard> shards;
+        THash hasher;
+
+        inline int shard_of(const TKey& x) const{
+            return hash_mix(hasher(x) + HASH_SEED) >> (63 - bits) >> 1;
+        }
+
+        /// Runs f(s) for every shard s, on up to threads threads which each take a range of shards
+        template <typename F>
+        void parallel_shards(F f, int threads){
+            int n = shards.size();
+            threads = max(1, min(threads, n));
+
+            vector<thread> pool;
+            auto run = [&](int t){
+                for (int s = (long long)n * t / threads; s < (long long)n * (t + 1) / threads; s++) f(s);
+            };
+            for (int t = 1; t < threads; t++) pool.emplace_back(run, t);
+            run(0);
+            for (auto&& th: pool) th.join();
+        }
+
+    public:
+        /// A per-thread batch of adds to a ConcurrentHashMap
+        class Buffer{
+            private:
+                ConcurrentHashMap& target;
+                vector<vector<pair<TKey, TValue>>> pending;
+
+                /// Applies the adds of shard s, or only tries to if force is false and the batch is not too large yet
+                void flush(int s, bool force){
+                    Shard& shard = target.shards[s];
+                    unique_lock<mutex> guard(shard.lock, try_to_lock);
+                    if (!guard.owns_lock()){
+                        if (!force && pending[s].size() < 4 * BUFFER_SIZE) return;
+                        guard.lock();
+                    }
+
+                    for (auto&& p: pending[s]) shard.map.add(p.first, p.second);
+                    pending[s].clear();
+                }
+
+            public:
+                Buffer(ConcurrentHashMap& target): target(target), pending(target.shards.size()){}
+
+                Buffer(const Buffer&) = delete;
+                Buffer& operator=(const Buffer&) = delete;
+
+                ~Buffer(){
+                    flush();
+                }
+
+                void add(const TKey& x, const TValue& v){
+                    int s = target.shard_of(x);
+                    pending[s].emplace_back(x, v);
+                    if (pending[s].size() >= BUFFER_SIZE) flush(s, false);
+                }
+
+                void flush(){
+                    for (int s = 0; s < (int)pending.size(); s++){
+                        if (!pending[s].empty()) flush(s, true);
+                    }
+                }
+        };
+
+        /// 2^shard_bits shards, at least a few times the number of threads keeps waiting rare
+        ConcurrentHashMap(int shard_bits = 8, const THash& hasher = THash()): bits(shard_bits), shards(1 << shard_bits), hasher(hasher){}
+
+        /// Makes room for n entries in total, assuming they are spread evenly over the shards
+        void reserve(int n){
+            for (auto&& shard: shards){
+                lock_guard<mutex> guard(shard.lock);
+                shard.map.reserve(n / shards.size() + n / shards.size() / 8 + 16);
+            }
+        }
+
+        void set(const TKey& x, const TValue& v){
+            Shard& shard = shards[shard_of(x)];
+            lock_guard<mutex> guard(shard.lock);
+            shard.map.set(x, v);
+        }
+
+        void add(const TKey& x, const TValue& v){
+            Shard& shard = shards[shard_of(x)];
+            lock_guard<mutex> guard(shard.lock);
+            shard.map.add(x, v);
+        }
+
+        TValue get(const TKey& x){
+            Shard& shard = shards[shard_of(x)];
+            lock_guard<mutex> guard(shard.lock);
+            return shard.map.get(x);
+        }
+
+        void erase(const TKey& x){
+            Shard& shard = shards[shard_of(x)];
+            lock_guard<mutex> guard(shard.lock);
+            shard.map.erase(x);
+        }
+
+        bool contains(const TKey& x){
+            Shard& shard = shards[shard_of(x)];
+            lock_guard<mutex> guard(shard.lock);
+            return shard.map.contains(x);
+        }
+
+        void clear(){
+            for (auto&& shard: shards){
+                lock_guard<mutex> guard(shard.lock);
+                shard.map.clear();
+            }
+        }
+
+        int size(){
+            int res = 0;
+            for (auto&& shard: shards){
+                lock_guard<mutex> guard(shard.lock);
+                res += shard.map.size();
+            }
+            return res;
+        }
+
+        /// f is called from several threads at once, but never twice for the same key
+        template <typename F>
+        void for_each(F f, int threads = thread::hardware_concurrency()){
+            parallel_shards([&](int s){
+                lock_guard<mutex> guard(shards[s].lock);
+                shards[s].map.for_each(f);
+            }, threads);
+        }
+
+        void merge(ConcurrentHashMap& other, int threads = thread::hardware_concurrency()){
+            if (&other == this) return;
+            if (other.shards.size() != shards.size()){
+                /// A shard of other is copied out under its lock and added after releasing it, since holding it while
+                /// locking shards of this map would deadlock against a merge the other way around
+                other.parallel_shards([&](int s){
+                    vector<pair<TKey, TValue>> entries;
+                    {
+                        lock_guard<mutex> guard(other.shards[s].lock);
+                        other.shards[s].map.for_each([&](const TKey& x, const TValue& v){ entries.emplace_back(x, v); });
+                    }
+                    for (auto&& p: entries) add(p.first, p.second);
+                }, threads);
+                return;
+            }
+
+            parallel_shards([&](int s){
+                scoped_lock guard(shards[s].lock, other.shards[s].lock);
+                other.shards[s].map.for_each([&](const TKey& x, const TValue& v){ shards[s].map.add(x, v); });
+            }, threads);
+        }
 };
 
 int main(){
@@ -134,5 +1048,140 @@ int main(){
     hashmap.clear();
     assert(hashmap.size() == 0);
 
+    /// Grows from nothing, and erasing keeps the keys which collided with the erased ones reachable
+    HashMap<long long, int> growing;
+    for (int i = 0; i < 100000; i++) growing.set(1LL * i * i, i);
+    for (int i = 0; i < 100000; i += 2) growing.erase(1LL * i * i);
+    for (int i = 0; i < 100000; i++) assert(growing.get(1LL * i * i) == (i & 1 ? i : 0));
+    assert(growing.size() == 50000);
+
+    /// Batched versions, the table grows in the middle of add_many
+    HashMap<long long, int> batch;
+    vector<long long> batch_keys;
+    for (int i = 0; i < 1000; i++) batch_keys.push_back(1LL * i * i % 500);
+    batch.add_many(batch_keys, vector<int>(1000, 1));
+
+    vector<int> batch_counts;
+    batch.get_many({0, 1, 4, 2, 499}, batch_counts);
+    assert(batch_counts == vector<int>({20, 8, 8, 0, 0}));
+
+    /// Iterating, and the same entries read back from a file, or mapped from it
+    long long key_sum = 0, value_sum = 0;
+    for (auto [key, value]: growing) key_sum += key, value_sum += value, value++;
+    assert(key_sum == 166666666650000LL && value_sum == 2500000000LL && growing.get(1) == 2);
+
+    const char* path = "hashmap_snapshot.bin";
+    assert(growing.save(path));
+
+    HashMap<long long, int> loaded;
+    assert(loaded.load(path) && loaded.size() == 50000 && loaded.get(9) == 4 && !loaded.contains(4));
+    loaded.add(4, 1);
+    assert(loaded.get(4) == 1 && loaded.size() == 50001);
+
+    HashMapView<long long, int> view;
+    assert(view.load(path) && view.size() == 50000 && view.get(99980001) == 10000 && !view.contains(2));
+    HashMapView<int, int> wrong_types;
+    assert(!wrong_types.load(path) && !view.load("missing.bin") && view.size() == 50000);
+
+    int entries = 0;
+    for (auto [key, value]: view) entries += growing.get(key) == value;
+    assert(entries == 50000);
+    remove(path);
+
+    HashMap<pair<int, int>, long long> pairs;
+    pairs.add({1, 2}, 5), pairs.add({2, 1}, 7), pairs.add({1, 2}, 1);
+    assert(pairs.get({1, 2}) == 6 && pairs.get({2, 1}) == 7 && pairs.size() == 2);
+
+    HashMap<string, int> words;
+    for (string s: {"hash", "map", "hash", "a", ""}) words.add(s, 1);
+    assert(words.get("hash") == 2 && words.get("") == 1 && words.get("maps") == 0);
+
+    /// Struct keys with a custom hasher
+    struct Point{
+        int x, y, z;
+        bool operator==(const Point& other) const{
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+    struct PointHasher{
+        uint64_t operator()(const Point& p) const{
+            return hash_combine(hash_combine(p.x, p.y), p.z);
+        }
+    };
+
+    HashMap<Point, int, PointHasher> points;
+    points.set({1, 2, 3}, 4);
+    assert(points.get({1, 2, 3}) == 4 && !points.contains({3, 2, 1}));
+
+    /// The Swiss table is used the same way, and keeps working while erasing at a load of 7/8
+    SwissHashMap<long long, int> swiss;
+    for (int i = 0; i < 100000; i++) swiss.add(1LL * i * i, i);
+    for (int i = 0; i < 100000; i += 2) swiss.erase(1LL * i * i);
+    for (int i = 0; i < 100000; i++) assert(swiss.get(1LL * i * i) == (i & 1 ? i : 0));
+    assert(swiss.size() == 50000);
+
+    /// With 2 groups, keys with hash 0 start at group 0 and keys with hash 2^63 at group 1, whatever the salt
+    /// Both groups overflow into each other at a load still below 7/8, lookups of missing keys must end anyway
+    struct SplitHasher{
+        uint64_t operator()(long long x) const{
+            return x < 1000 ? 0 : 1ULL << 63;
+        }
+    };
+
+    SwissHashMap<long long, int, SplitHasher> small;
+    for (int i = 0; i <= 16; i++) small.add(i, 1);
+    for (int i = 0; i < 5; i++) small.erase(i);
+    for (int i = 1000; i < 1016; i++) small.add(i, 1);
+    assert(small.size() == 28 && !small.contains(-1) && !small.contains(2000) && small.get(16) == 1);
+
+    small.add(-1, 1), small.add(2000, 1);
+    for (int i = 5; i <= 16; i++) assert(small.get(i) == 1);
+    for (int i = 1000; i < 1016; i++) assert(small.get(i) == 1);
+    assert(small.size() == 30 && small.get(-1) == 1 && small.get(2000) == 1);
+
+    swiss.clear();
+    assert(swiss.size() == 0 && !swiss.contains(1));
+
+    long long total = 0;
+    swiss.add(3, 4), swiss.add(5, 6);
+    swiss.for_each([&](long long key, int value){ total += key * value; });
+    assert(total == 42);
+
+    /// Group-by counting on 4 threads, each with its own buffer
+    ConcurrentHashMap<int, long long> counts;
+    vector<thread> pool;
+    for (int t = 0; t < 4; t++){
+        pool.emplace_back([&counts, t](){
+            ConcurrentHashMap<int, long long>::Buffer buffer(counts);
+            for (int i = 0; i < 100000; i++) buffer.add(i % 30000, t + 1);
+        });
+    }
+    for (auto&& th: pool) th.join();
+
+    assert(counts.size() == 30000);
+    for (int i = 0; i < 30000; i++) assert(counts.get(i) == (i < 10000 ? 40 : 30));
+
+    atomic<long long> sum(0);
+    counts.for_each([&](int, long long value){ sum += value; }, 4);
+    assert(sum == 1000000);
+
+    ConcurrentHashMap<int, long long> more;
+    more.add(0, 1), more.set(-1, 5);
+    counts.merge(more);
+    assert(counts.get(0) == 41 && counts.get(-1) == 5 && counts.size() == 30001);
+
+    /// Merges in opposite directions at the same time between maps with different shard counts
+    for (int round = 0; round < 100; round++){
+        ConcurrentHashMap<int, int> left(4), right(6);
+        for (int i = 0; i < 20000; i++) (i & 1 ? right : left).add(i, 1);
+
+        thread other([&](){ right.merge(left, 4); });
+        left.merge(right, 4);
+        other.join();
+
+        assert(left.size() == 20000 && right.size() == 20000);
+        for (int i = 0; i < 20000; i++) assert(left.get(i) >= 1 && right.get(i) >= 1);
+    }
+
     return 0;
 }
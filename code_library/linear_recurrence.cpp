@@ -1,11 +1,19 @@
 /***
  * Generalized linear recurrence solver for recurrence with high degrees
  * Algorithm uses a combination of Berlekamp-Massey and Reeds-Sloane to derive the recurrence
- * Then it converts the recurrence to a polynomial and evaluates the n'th term efficiently using fast fourier transform
+ * Then it converts the recurrence to a polynomial and evaluates the n'th term efficiently using number theoretic transform
+ * Single terms use Bostan-Mori on the generating function P(x) / Q(x), which needs no division and works for any mod
  *
  * Overall complexity is roughly O(k^2) + O(k * log k * log n) with high constant factors
  * O(k^2) is for initialization only and can be skipped if the recurrence is known
+ * For prime mods and long sequences, initialization uses a half-GCD based Berlekamp-Massey in O(k * log^2 k) instead
+ * Prime power factors of composite mods are solved on separate threads, so compile with -pthread
  * O(k * log k * log n) accounts for each query to calculate the n'th term
+ * The part of Bostan-Mori that does not depend on n is done once and shared by all the queries
+ *
+ * LinearRecurrence<int> supports mods below 2^31 and LinearRecurrence<long long> supports mods up to 2^62
+ * Polynomial products are exact, they are computed modulo up to five NTT primes and combined with Garner's algorithm
+ * Every instance keeps its own mod, so recurrences with different mods can be used side by side, even on different threads
  *
  * Thanks to anta(https://codeforces.com/profile/anta) for first showing me this cool trick and recommending the Black Box Linear Algebra book
  *
@@ -15,378 +23,450 @@
 #include <stdio.h>
 #include <bits/stdtr1c++.h>
 
-#define MAX 131072
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define NTT_X86_KERNELS
+#endif
 
 using namespace std;
 
 namespace nt{
-    map <int, map<int, int>> factors_map;
+    typedef unsigned long long ull;
+    typedef unsigned __int128 u128;
 
-    map <int, int> get_factors(int mod){
-        if (factors_map.count(mod)) return factors_map[mod];
+    /// Type wide enough to hold the product of two values of type Int
+    template <typename Int> struct wide{ typedef ull type; };
+    template <> struct wide<long long>{ typedef u128 type; };
+
+    inline long long mul(long long a, long long b, long long mod){
+        return (u128)a * b % mod;
+    }
+
+    long long expo(long long x, long long n, long long mod){
+        long long res = 1 % mod;
+        for (x %= mod; n; n >>= 1, x = mul(x, x, mod)){
+            if (n & 1) res = mul(res, x, mod);
+        }
+        return res;
+    }
+
+    /// Deterministic Miller-Rabin for 64 bit integers, see miller_rabin.cpp
+    bool is_prime(long long n){
+        if (n < 2) return false;
+        for (long long p: {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}){
+            if (n % p == 0) return n == p;
+        }
+
+        int r = __builtin_ctzll(n - 1);
+        long long d = (n - 1) >> r;
+        for (long long a: {2, 325, 9375, 28178, 450775, 9780504, 1795265022}){
+            long long x = expo(a, d, n);
+            if (x == 0 || x == 1 || x == n - 1) continue;
+
+            for (int i = 1; i < r && x != n - 1; i++) x = mul(x, x, n);
+            if (x != n - 1) return false;
+        }
+        return true;
+    }
 
-        long long d, x = mod;
-        map <int, int> factors;
-        for (d = 2; d * d <= x; d += (d & 1) + 1){
-            while (x % d == 0){
+    /// Returns a non-trivial factor of the odd composite n with Pollard's rho (Brent's variant)
+    long long pollard_rho(long long n){
+        static thread_local mt19937_64 rng(n);
+        while (true){
+            long long x = rng() % n, y = x, ys = x, c = rng() % (n - 1) + 1, q = 1, g = 1;
+            auto f = [&](long long v){ return (mul(v, v, n) + c) % n; };
+
+            for (int r = 1; g == 1; r <<= 1){
+                x = y;
+                for (int i = 0; i < r; i++) y = f(y);
+                for (int k = 0; k < r && g == 1; k += 128){
+                    ys = y;
+                    for (int i = 0; i < min(128, r - k); i++) y = f(y), q = mul(q, abs(x - y), n);
+                    g = __gcd(q, n);
+                }
+            }
+
+            if (g == n){
+                do ys = f(ys), g = __gcd(abs(x - ys), n); while (g == 1);
+            }
+            if (g != n) return g;
+        }
+    }
+
+    void factorize(long long n, map <long long, int>& factors){
+        if (n == 1) return;
+        if (is_prime(n)){
+            factors[n]++;
+            return;
+        }
+
+        for (long long d: {2, 3, 5, 7, 11, 13}){
+            if (n % d == 0){
                 factors[d]++;
-                x /= d;
+                return factorize(n / d, factors);
             }
         }
-        if (x > 1) factors[x]++;
+        long long d = pollard_rho(n);
+        factorize(d, factors), factorize(n / d, factors);
+    }
+
+    map <long long, map<long long, int>> factors_map;
+
+    /// Cached factorization of mod, safe to call from several threads at once
+    map <long long, int> get_factors(long long mod){
+        static mutex factors_lock;
+        lock_guard <mutex> guard(factors_lock);
+        if (factors_map.count(mod)) return factors_map[mod];
 
+        map <long long, int> factors;
+        factorize(mod, factors);
         return factors_map[mod] = factors;
     }
 
-    int extended_gcd(int a, int b, int& x, int& y){
+    long long extended_gcd(long long a, long long b, long long& x, long long& y){
         if (!b){
             y = 0, x = 1;
             return a;
         }
 
-        int g = extended_gcd(b, a % b, y, x);
+        long long g = extended_gcd(b, a % b, y, x);
         y -= ((a / b) * x);
         return g;
     }
 
-    int mod_inverse(int a, int mod){
-        int x, y;
+    long long mod_inverse(long long a, long long mod){
+        long long x, y;
         extended_gcd(a, mod, x, y);
-        return (x + mod) % mod;
+        return (x % mod + mod) % mod;
     }
 
-    int chinese_remainder_theorem(vector <int> ar, vector <int> mods){
-        int i, res = 0, mod = 1;
+    long long chinese_remainder_theorem(vector <long long> ar, vector <long long> mods){
+        int i;
+        long long res = 0, mod = 1;
         for (auto m: mods) mod *= m;
 
         for (i = 0; i < (int)ar.size(); i++){
             long long x = mod / mods[i];
-            long long y = mod_inverse(x, mods[i]);
-            res = (res + (x * ar[i] % mod) * y) % mod;
+            long long y = mod_inverse(x % mods[i], mods[i]);
+            res = (res + mul(mul(x, ar[i], mod), y, mod)) % mod;
         }
 
         return res;
     }
 
-    int convolution(int* A, int* B, int n, int mod){
-        unsigned long long res = 0;
-        int i, j, lim = min(ULONG_LONG_MAX / ((unsigned long long)mod * mod), (unsigned long long)n);
+    /// Sum of A[i] * B[i] modulo mod, reduced only as often as the wide type would overflow
+    template <typename Int>
+    long long convolution(const Int* A, const Int* B, int n, long long mod){
+        typedef typename wide<Int>::type W;
+
+        W res = 0;
+        int i, j, lim = min((W)n, (W)-1 / ((W)mod * mod));
 
         for (i = 0; (i + lim) <= n; res %= mod){
-            for (j = 0; j < lim; j++, i++) res += (unsigned long long)A[i] * B[i];
+            for (j = 0; j < lim; j++, i++) res += (W)A[i] * B[i];
         }
 
-        for (j = 0; i < n; i++) res += (unsigned long long)A[i] * B[i];
+        for (j = 0; i < n; i++) res += (W)A[i] * B[i];
         return res % mod;
     }
 }
 
-namespace fft{
-    bool initialized = false;
-    int len, last = 0, A[MAX], B[MAX], rev[MAX];
-
-    struct ComplexNum{
-        double real, img;
+namespace ntt{
+    /// Montgomery form with R = 2^32, mod must be odd and less than 2^30
+    struct Montgomery{
+        uint32_t mod, mod2, inv, r2;
 
-        inline ComplexNum(double real=0.0, double img=0.0) : real(real), img(img) {}
-
-        inline ComplexNum conjugate(){
-            return ComplexNum(real, -img);
+        Montgomery(uint32_t mod=1) : mod(mod), mod2(mod * 2){
+            inv = mod;
+            for (int i = 0; i < 5; i++) inv *= 2 - mod * inv;
+            inv = -inv;
+            r2 = (-(uint64_t)mod) % mod;
         }
 
-        inline ComplexNum operator + (ComplexNum other){
-            return ComplexNum(real + other.real, img + other.img);
+        /// x must be less than mod * 2^32, result is in [0, 2 * mod)
+        inline uint32_t reduce(uint64_t x) const{
+            return (x + (uint64_t)((uint32_t)x * inv) * mod) >> 32;
         }
 
-        inline ComplexNum operator - (ComplexNum other){
-            return ComplexNum(real - other.real, img - other.img);
+        inline uint32_t mul(uint32_t a, uint32_t b) const{
+            return reduce((uint64_t)a * b);
         }
 
-        inline ComplexNum operator * (ComplexNum other){
-            return ComplexNum((real * other.real) - (img * other.img), (real * other.img) + (img * other.real));
+        inline uint32_t add(uint32_t a, uint32_t b) const{
+            a += b;
+            return a >= mod2 ? a - mod2 : a;
         }
-    } u[MAX], v[MAX], f[MAX], g[MAX], dp[MAX];
-
-    void initialize(){
-        if (initialized) return;
 
-        int i, j, lim;
-        initialized = true, dp[1] = ComplexNum(1);
+        inline uint32_t sub(uint32_t a, uint32_t b) const{
+            a += mod2 - b;
+            return a >= mod2 ? a - mod2 : a;
+        }
 
-        for (i = 1; (1 << i) < MAX; i++){
-            double theta = (2.0 * acos(0.0)) / (1 << i);
-            auto mul = ComplexNum(cos(theta), sin(theta));
-            for (lim = 1 << i, j = lim >> 1; j < lim; j++){
-                dp[2 * j] = dp[j];
-                dp[2 * j + 1] = dp[j] * mul;
-            }
+        inline uint32_t normalize(uint32_t x) const{
+            return x >= mod ? x - mod : x;
         }
-    }
 
-    void build(int& a, int* A, int& b, int* B){
-        while (a > 1 && A[a - 1] == 0) a--;
-        while (b > 1 && B[b - 1] == 0) b--;
+        inline uint32_t to_mont(uint32_t x) const{
+            return normalize(mul(x, r2));
+        }
+    };
 
-        int i, nbits;
-        len = 1 << (32 - __builtin_clz(a + b) - (__builtin_popcount(a + b) == 1));
-        for (i = a; i < len; i++) A[i] = 0;
-        for (i = b; i < len; i++) B[i] = 0;
+    /// The product of all five primes exceeds 2^145, enough for the exact product of two polynomials modulo 2^62
+    const int PRIMES = 5;
+    const uint32_t PRIME[PRIMES] = {754974721, 167772161, 469762049, 998244353, 880803841};
 
-        initialize();
+    int get_bit(int len){
+        return 32 - __builtin_clz(len) - (__builtin_popcount(len) == 1);
+    }
 
-        if (last != len){
-            last = len;
-            nbits = (32 - __builtin_clz(len) - (__builtin_popcount(len) == 1));
+#ifdef NTT_X86_KERNELS
+    bool has_avx2 = __builtin_cpu_supports("avx2");
+
+    /// Montgomery reduction of a * b in every 32 bit lane, same as Montgomery::mul
+    __attribute__((target("avx2")))
+    inline __m256i montgomery_mul(__m256i a, __m256i b, __m256i mod, __m256i inv){
+        __m256i even = _mm256_mul_epu32(a, b);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+        even = _mm256_add_epi64(even, _mm256_mul_epu32(_mm256_mul_epu32(even, inv), mod));
+        odd = _mm256_add_epi64(odd, _mm256_mul_epu32(_mm256_mul_epu32(odd, inv), mod));
+        return _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    }
 
-            for (i = 0; i < len; i++){
-                rev[i] = (rev[i >> 1] >> 1) + ((i & 1) << (nbits - 1));
-            }
+    /// (a, b) = (a + b, (a - b) * w) for count butterflies, count must be a multiple of 8
+    __attribute__((target("avx2")))
+    void forward_avx2(const Montgomery& mt, uint32_t* a, uint32_t* b, const uint32_t* w, int count){
+        __m256i mod = _mm256_set1_epi32(mt.mod), mod2 = _mm256_set1_epi32(mt.mod2), inv = _mm256_set1_epi32(mt.inv);
+        for (int j = 0; j < count; j += 8){
+            __m256i x = _mm256_loadu_si256((__m256i*)(a + j)), y = _mm256_loadu_si256((__m256i*)(b + j));
+            __m256i s = _mm256_add_epi32(x, y), d = _mm256_sub_epi32(_mm256_add_epi32(x, mod2), y);
+            s = _mm256_min_epu32(s, _mm256_sub_epi32(s, mod2));
+            _mm256_storeu_si256((__m256i*)(a + j), s);
+            _mm256_storeu_si256((__m256i*)(b + j), montgomery_mul(d, _mm256_loadu_si256((__m256i*)(w + j)), mod, inv));
         }
     }
 
-    void transform(ComplexNum *in, ComplexNum *out){
-        int i, j, k;
-        for (i = 0; i < len; i++) out[i] = in[rev[i]];
-
-        for (k = 1; k < len; k <<= 1){
-            for (i = 0; i < len; i += (k << 1)){
-                for (j = 0; j < k; j++){
-                    auto z = out[i + j + k] * dp[j + k];
-                    out[i + j + k] = out[i + j] - z;
-                    out[i + j] = out[i + j] + z;
-                }
-            }
+    /// (a, b) = (a + b * w, a - b * w) for count butterflies, count must be a multiple of 8
+    __attribute__((target("avx2")))
+    void inverse_avx2(const Montgomery& mt, uint32_t* a, uint32_t* b, const uint32_t* w, int count){
+        __m256i mod = _mm256_set1_epi32(mt.mod), mod2 = _mm256_set1_epi32(mt.mod2), inv = _mm256_set1_epi32(mt.inv);
+        for (int j = 0; j < count; j += 8){
+            __m256i x = _mm256_loadu_si256((__m256i*)(a + j));
+            __m256i y = montgomery_mul(_mm256_loadu_si256((__m256i*)(b + j)), _mm256_loadu_si256((__m256i*)(w + j)), mod, inv);
+            __m256i s = _mm256_add_epi32(x, y), d = _mm256_sub_epi32(_mm256_add_epi32(x, mod2), y);
+            _mm256_storeu_si256((__m256i*)(a + j), _mm256_min_epu32(s, _mm256_sub_epi32(s, mod2)));
+            _mm256_storeu_si256((__m256i*)(b + j), _mm256_min_epu32(d, _mm256_sub_epi32(d, mod2)));
         }
     }
+#endif
+
+    /// Transforms are done in place, forward leaves the result in bit-reversed order and inverse takes it back
+    struct NTT{
+        Montgomery mt;
+        uint32_t mod, root;
+        int max_len;
+        vector <uint32_t> rt, irt, f, g;  /// rt[h + j] = w^j where w is the principal (2h)'th root of unity
+
+        NTT(uint32_t mod=0) : mt(mod | 1), mod(mod), root(0), max_len(1), rt(2, 0), irt(2, 0){
+            if (!mod) return;
+            while ((mod - 1) % (2 * max_len) == 0) max_len *= 2;
+
+            vector <uint32_t> factors;
+            uint32_t d, x = mod - 1;
+            for (d = 2; d * d <= x; d++){
+                if (x % d == 0) factors.push_back(d);
+                while (x % d == 0) x /= d;
+            }
+            if (x > 1) factors.push_back(x);
 
-    vector <int> mod_multiply(vector <int>& p1, vector <int>& p2, int mod){
-        int i, j, a = 0, b = 0, p_len = -1;
-        for (auto x: p1) A[a++] = x, p_len++;
-        for (auto x: p2) B[b++] = x, p_len++;
-
-        build(a, A, b, B);
-        for (i = 0; i < min(a, b) && A[i] == B[i]; i++) {}
-        bool is_equal = (a == b && i == a);
+            for (root = 2; ; root++){
+                bool flag = true;
+                for (auto p: factors) flag = flag && nt::expo(root, (mod - 1) / p, mod) != 1;
+                if (flag) break;
+            }
 
-        for (i = 0; i < len; i++){
-            A[i] %= mod, B[i] %= mod;
-            u[i] = ComplexNum(A[i] & 32767, A[i] >> 15);
-            v[i] = ComplexNum(B[i] & 32767, B[i] >> 15);
+            rt[1] = irt[1] = mt.to_mont(1);
         }
 
-        transform(u, f);
-        for (int i = 0; i < len; i++) g[i] = f[i];
-        if (!is_equal) transform(v, g);
+        void build(int len){
+            assert(len <= max_len);
 
-        for (i = 0; i < len; i++){
-            j = (len - 1) & (len - i);
-            auto c1 = f[j].conjugate(), c2 = g[j].conjugate();
-            auto a1 = (f[i] + c1) * ComplexNum(0.5, 0);
-            auto a2 = (f[i] - c1) * ComplexNum(0, -0.5);
-            auto b1 = (g[i] + c2) * ComplexNum(0.5 / len, 0);
-            auto b2 = (g[i] - c2) * ComplexNum(0, -0.5 / len);
-            v[j] = a1 * b2 + a2 * b1;
-            u[j] = a1 * b1 + a2 * b2 * ComplexNum(0, 1);
-        }
-
-        transform(u, f);
-        transform(v, g);
+            for (int h = rt.size() >> 1; 2 * h < len; h <<= 1){
+                rt.resize(4 * h), irt.resize(4 * h);
+                uint32_t w = mt.to_mont(nt::expo(root, (mod - 1) / (4 * h), mod));
+                uint32_t iw = mt.to_mont(nt::expo(nt::expo(root, mod - 2, mod), (mod - 1) / (4 * h), mod));
 
-        memset(A, 0, sizeof(A));
-        for (i = 0; i < len; i++){
-            long long x = f[i].real + 0.5, y = g[i].real + 0.5, z = f[i].img + 0.5;
-            A[i] = (x + ((y % mod) << 15) + ((z % mod) << 30)) % mod;
+                for (int j = 0; j < 2 * h; j++){
+                    rt[2 * h + j] = j & 1 ? mt.normalize(mt.mul(rt[h + (j >> 1)], w)) : rt[h + (j >> 1)];
+                    irt[2 * h + j] = j & 1 ? mt.normalize(mt.mul(irt[h + (j >> 1)], iw)) : irt[h + (j >> 1)];
+                }
+            }
         }
 
-        return vector <int>(A, A + p_len);
-    }
-}
-
-int _POLYNOMIAL_MOD;
-
-struct Polynomial{
-    vector <int> coefficient;
-    Polynomial(vector <int> coefficient={}) : coefficient(coefficient) {}
-
-    inline int* data(){
-        return coefficient.empty() ? 0 : &coefficient[0];
-    }
-
-    inline void copy_poly(int* to, int* from, int n){
-        memcpy(to, from, n * sizeof(int));
-    }
-
-    inline void subtract(int* res, int* P, int pn, int* Q, int qn){
-        for(int i = 0; i < qn; i++){
-            res[i] = P[i] - Q[i];
-            if (res[i] < 0) res[i] += _POLYNOMIAL_MOD;
+        void forward(uint32_t* ar, int len){
+            for (int h = len >> 1; h >= 1; h >>= 1){
+                const uint32_t* w = &rt[h];
+                for (int i = 0; i < len; i += 2 * h){
+                    uint32_t *a = ar + i, *b = ar + i + h;
+#ifdef NTT_X86_KERNELS
+                    if (has_avx2 && h >= 8){
+                        forward_avx2(mt, a, b, w, h);
+                        continue;
+                    }
+#endif
+                    for (int j = 0; j < h; j++){
+                        uint32_t x = a[j], y = b[j];
+                        a[j] = mt.add(x, y);
+                        b[j] = mt.mul(x + mt.mod2 - y, w[j]);
+                    }
+                }
+            }
         }
-        copy_poly(res + qn, P + qn, pn - qn);
-    }
 
-    inline void shift(int* res, int* P, int n, int k){
-        for (int i = 0; i < n; i++){
-            res[i] = ((long long)P[i] << k) % _POLYNOMIAL_MOD;
+        void inverse(uint32_t* ar, int len){
+            for (int h = 1; h < len; h <<= 1){
+                const uint32_t* w = &irt[h];
+                for (int i = 0; i < len; i += 2 * h){
+                    uint32_t *a = ar + i, *b = ar + i + h;
+#ifdef NTT_X86_KERNELS
+                    if (has_avx2 && h >= 8){
+                        inverse_avx2(mt, a, b, w, h);
+                        continue;
+                    }
+#endif
+                    for (int j = 0; j < h; j++){
+                        uint32_t x = a[j], y = mt.mul(b[j], w[j]);
+                        a[j] = mt.add(x, y);
+                        b[j] = mt.sub(x, y);
+                    }
+                }
+            }
         }
-    }
 
-    inline void reverse_poly(int* res, int* P, int n){
-        if (&res[0] == &P[0]) return reverse(res, res + n);
-        for (int i = 0; i < n; i++) res[n - i - 1] = P[i];
-    }
+        /// Product of a[0, n) and b[0, m) modulo this prime, the first p_len values are left in f
+        template <typename Int>
+        void multiply(const Int* a, int n, const Int* b, int m, int p_len, bool is_equal){
+            int i, len = 1 << get_bit(p_len);
+            build(len);
 
-    inline int size(){
-        return coefficient.size();
-    }
+            f.assign(len, 0);
+            for (i = 0; i < n; i++) f[i] = a[i] % mod;
+            forward(f.data(), len);
 
-    inline void normalize(){
-        while (size() && !coefficient.back()) coefficient.pop_back();
-    }
+            if (is_equal) g = f;
+            else{
+                g.assign(len, 0);
+                for (i = 0; i < m; i++) g[i] = b[i] % mod;
+                forward(g.data(), len);
+            }
 
-    void multiply(Polynomial &res, Polynomial& p, Polynomial& q){
-        if(&res == &p || &res == &q){
-            Polynomial temp;
-            multiply(temp, p, q);
-            res = temp;
-            return;
-        }
+            /// The pointwise product introduces a factor of 1/R, which is cancelled along with 1/len at the end
+            for (i = 0; i < len; i++) f[i] = mt.mul(f[i], g[i]);
+            inverse(f.data(), len);
 
-        res.coefficient.clear();
-        if (p.size() && q.size()){
-            res.coefficient = fft::mod_multiply(p.coefficient, q.coefficient, _POLYNOMIAL_MOD);
+            uint32_t scale = mt.to_mont(mt.to_mont(nt::expo(len, mod - 2, mod)));
+            for (i = 0; i < p_len; i++) f[i] = mt.normalize(mt.mul(f[i], scale));
         }
-    }
-
-    Polynomial inverse(int n){
-        Polynomial res({n});
-        res.coefficient.resize(n);
-        find_inverse(res.data(), n, data(), size());
-        return res;
-    }
-
-    void divide(Polynomial &quot, Polynomial &rem, Polynomial &p, Polynomial &q, Polynomial &inv){
-        int pn = p.size(), qn = q.size();
-        quot.coefficient.resize(max((int)0, pn - qn + 1)), rem.coefficient.resize(qn - 1);
-        divide_remainder_inverse(quot.data(), rem.data(), p.data(), pn, q.data(), qn, inv.data());
-        quot.normalize(), rem.normalize();
-    }
+    };
 
-    Polynomial remainder(Polynomial &q, Polynomial &inv){
-        Polynomial quot, rem;
-        divide(quot, rem, *this, q, inv);
-        return rem;
+    /// Every thread gets its own engines, so that roots and scratch arrays are never shared
+    NTT& get_engine(int idx){
+        static thread_local vector <NTT> engines(PRIME, PRIME + PRIMES);
+        return engines[idx];
     }
 
-    Polynomial power(Polynomial &q, long long k){
-        int qn = q.size();
-        if(qn == 1) return Polynomial();
-        if(k == 0) return Polynomial({1});
-        Polynomial inv = q.inverse(max(size() - qn + 1, qn));
-        Polynomial p = this->remainder(q, inv);
-
-        Polynomial res = p;
-        for(int l = 62 - __builtin_clzll(k); l >= 0; l--){
-            multiply(res, res, res);
-            res = res.remainder(q, inv);
-
-            if (k & (1LL << l)){
-                multiply(res, res, p);
-                res = res.remainder(q, inv);
+    /***
+     * Product of p1 and p2 modulo mod, values must be in [0, mod) and mod at most 2^62
+     * Uses as many primes as the exact product needs, which is three for mods below 2^31
+     * If mod is one of the primes, a single transform is enough
+     *
+    ***/
+    template <typename Int>
+    vector <Int> mod_multiply(const vector <Int>& p1, const vector <Int>& p2, long long mod){
+        int i, j, k, n = p1.size(), m = p2.size(), p_len = n + m - 1, cnt = 0;
+        bool is_equal = (p1 == p2);
+
+        for (i = 0; i < PRIMES; i++){
+            if (mod == PRIME[i] && p_len <= get_engine(i).max_len){
+                NTT& engine = get_engine(i);
+                engine.multiply(p1.data(), n, p2.data(), m, p_len, is_equal);
+                return vector <Int>(engine.f.begin(), engine.f.begin() + p_len);
             }
         }
-        return res;
-    }
 
-    void multiply(int* res, int* P, int pn, int* Q, int qn){
-        auto P1 = Polynomial(vector<int>(P, P + pn));
-        auto P2 = Polynomial(vector<int>(Q, Q + qn));
+        /// Every coefficient of the exact product is below min(n, m) * (mod - 1)^2
+        long double bits = 0, need = log2l(min(n, m)) + 2 * log2l(mod) + 1;
+        while (bits < need && cnt < PRIMES) bits += log2l(PRIME[cnt++]);
+        assert(bits >= need);
 
-        Polynomial P_res;
-        P_res.multiply(P_res, P1, P2);
-        for (int i = 0; i < (int)P_res.coefficient.size(); i++){
-            res[i] = P_res.coefficient[i];
-        }
-    }
+        for (k = 0; k < cnt; k++) get_engine(k).multiply(p1.data(), n, p2.data(), m, p_len, is_equal);
 
-    void inverse_power_series(int* res, int res_n, int* P, int pn){
-        if(res_n == 0) return;
-        unique_ptr <int[]> ptr(new int[res_n * sizeof(int)]);
-        int* u = ptr.get(), *v = u + res_n * 2, cur = 1, nxt = 1;
-
-        for (int i = 0; i < res_n; i++) res[i] = 0;
-        res[0] = P[0];
-        while (cur < res_n){
-            nxt = min(res_n, cur * 2);
-            multiply(u, res, cur, res, cur);
-            multiply(v, u, min(nxt, cur * 2 - 1), P, min(nxt, pn));
-            shift(res, res, cur, 1);
-            subtract(res, res, nxt, v, nxt);
-            cur = nxt;
-        }
-    }
-
-    void find_inverse(int* res, int res_n, int* P, int pn){
-        unique_ptr <int[]> ptr(new int[pn]);
-        int* tmp = ptr.get();
-        reverse_poly(tmp, P, pn);
-        inverse_power_series(res, res_n, tmp, pn);
-    }
-
-    void divide_inverse(int* res, int res_n, int* revp, int pn, int* inv){
-        unique_ptr <int[]> ptr(new int[pn + res_n]);
-        int* tmp = ptr.get();
-        multiply(tmp, revp, pn, inv, res_n);
-        reverse_poly(res, tmp, res_n);
-    }
+        /// Garner's algorithm, the exact value is c_0 + c_1 * P_0 + c_2 * P_0 * P_1 + ... where c_k is in [0, P_k)
+        static const auto inv = [](){
+            array <array<uint64_t, PRIMES>, PRIMES> inv;
+            for (int i = 0; i < PRIMES; i++){
+                for (int j = 0; j < i; j++) inv[i][j] = nt::expo(PRIME[j], PRIME[i] - 2, PRIME[i]);
+            }
+            return inv;
+        }();
+
+        long long radix[PRIMES];
+        for (radix[0] = 1 % mod, k = 1; k < cnt; k++) radix[k] = nt::mul(radix[k - 1], PRIME[k - 1], mod);
+
+        vector <Int> res(p_len);
+        uint64_t c[PRIMES];
+        for (i = 0; i < p_len; i++){
+            for (k = 0; k < cnt; k++){
+                c[k] = get_engine(k).f[i];
+                for (j = 0; j < k; j++) c[k] = (c[k] + PRIME[k] - c[j] % PRIME[k]) * inv[k][j] % PRIME[k];
+            }
 
-    void divide_remainder_inverse(int* quot, int* rem, int* P, int pn, int* Q, int qn, int* inv){
-        if(pn < qn){
-            copy_poly(rem, P, pn);
-            for (int i = 0; i < qn - pn - 1; i++) rem[i + pn] = 0;
-            return;
+            if (mod <= UINT_MAX){
+                uint64_t x = 0;
+                for (k = 0; k < cnt; k++) x += c[k] * radix[k] % mod;
+                res[i] = x % mod;
+            }
+            else{
+                nt::u128 x = 0;
+                for (k = 0; k < cnt; k++) x += (nt::u128)c[k] * radix[k];
+                res[i] = x % mod;
+            }
         }
-
-        if(qn == 1) return;
-        int quot_n = pn - qn + 1;
-        int rn = qn - 1, tn = min(quot_n, rn), un = tn + rn;
-        unique_ptr <int[]> ptr(new int[pn + un + (quot != 0 ? 0 : quot_n)]);
-
-        int* revp = ptr.get(), *qmul = revp + pn;
-        if(quot == 0) quot = qmul + un;
-
-        reverse_poly(revp, P, pn);
-        divide_inverse(quot, quot_n, revp, pn, inv);
-        multiply(qmul, Q, rn, quot, tn);
-        subtract(rem, P, rn, qmul, rn);
+        return res;
     }
-};
+}
 
+template <typename Int = int>
 struct LinearRecurrence{
+    static_assert(is_same<Int, int>::value || is_same<Int, long long>::value, "values must be int or long long");
+    typedef typename nt::wide<Int>::type W;
+
     long long mod;
-    vector <int> raw_base_sequence, base_sequence, recurrence;
+    vector <Int> raw_base_sequence, base_sequence, recurrence;
+
+    /// Generating function of the sequence as P(x) / Q(x), and chain[t] = Q_t(-x) where Q_0 = Q and Q_t+1(x^2) = Q_t(x) * Q_t(-x)
+    vector <Int> numerator;
+    vector <vector<Int>> chain;
 
     LinearRecurrence() {}
 
     /***
      * Construct linear recurrence from the first 2*n terms
      * sequence: base sequence of 2*n terms, where n >= k and recurrence has degree k
-     * mod: all values are considered modulo this number
+     * mod: all values are considered modulo this number, below 2^31 for int and at most 2^62 for long long
      * recurrence: an optional recurrence vector, calculated if not given
     ***/
 
-    LinearRecurrence(vector <int> sequence, int mod, vector<int> recurrence={}) : mod(mod), recurrence(recurrence){
+    LinearRecurrence(vector <Int> sequence, long long mod, vector<Int> recurrence={}) : mod(mod), recurrence(recurrence){
         int n = sequence.size(), m = n >> 1;
 
         if (n == 0 || (n % 2) != 0){
             throw std::invalid_argument("base sequence must be non-empty and of even length");
         }
 
-        if((long long)mod * 2 >= INT_MAX){
-            throw std::out_of_range("mod value out of range, consider replacing long long with __int128 and int with long long if need to support higher ranges and improve fft multiplication precision");
+        if (mod < 1 || mod > min((long long)numeric_limits<Int>::max(), 1LL << 62)){
+            throw std::out_of_range("mod value out of range, use LinearRecurrence<long long> for mods up to 2^62");
         }
 
-        _POLYNOMIAL_MOD = mod;
-
         for (int i = 0; i < n; i++){
             sequence[i] = ((long long)sequence[i] % mod + mod) % mod;
         }
@@ -396,8 +476,8 @@ struct LinearRecurrence{
 
         if (this->recurrence.size()){
             for (int i = 0; i < (int)this->recurrence.size(); i++){
-                this->recurrence[i] %= mod;
-                this->recurrence[i] = ((long long)mod - this->recurrence[i] + mod) % mod;
+                long long x = ((long long)this->recurrence[i] % mod + mod) % mod;
+                this->recurrence[i] = x ? mod - x : 0;
             }
         }
         else if (mod > 1){
@@ -407,41 +487,49 @@ struct LinearRecurrence{
         }
     }
 
-    long long find_rank(const vector <int> & v){
+    /// a * b modulo m
+    static inline Int mul(Int a, Int b, long long m){
+        return (W)a * b % m;
+    }
+
+    long long find_rank(const vector <Int> & v){
         return (v.size() > 1 || (v.size() == 1 && v[0])) ? v.size() - 1 : (long long)INT_MIN;
     }
 
-    long long compare(const vector <int> &a, const vector <int> &b) {
+    long long compare(const vector <Int> &a, const vector <Int> &b) {
         return max(find_rank(a), find_rank(b) + 1);
     };
 
-    void update(vector <int>& u, vector <int>& v, int m, long long c){
+    void update(vector <Int>& u, vector <Int>& v, int m, long long c){
         int i, k = v.size();
         if (k + m > (int)u.size()) u.resize(k + m, 0);
 
         for (i = 0; i < k; i++){
-            u[i + m] -= c * v[i] % mod;
+            u[i + m] -= mul(c, v[i], mod);
             if (u[i + m] < 0) u[i + m] += mod;
         }
         while (u.size() && !u.back()) u.pop_back();
     }
 
-    vector <int> reeds_sloane(vector <int> sequence, int p, int e){
-        vector <int> T(e), U(e), R(e), TO(e, 1), UO(e), POW(e + 1, 1);
-        int c, d, i, j, k, l, m, len = sequence.size(), mod = powl(p, e) + 0.5;
+    vector <Int> reeds_sloane(vector <Int> sequence, long long p, int e){
+        vector <long long> T(e), TO(e, 1), POW(e + 1, 1);
+        vector <int> U(e), R(e), UO(e);
+        int i, j, k, l, m, len = sequence.size();
+        long long c, d, mod = 1;
 
-        vector <vector<int>> A[3], B[3];
+        vector <vector<Int>> A[3], B[3];
         for (i = 0; i < 3; i++){
-            A[i] = vector <vector<int>>(e);
-            B[i] = vector <vector<int>>(e);
+            A[i] = vector <vector<Int>>(e);
+            B[i] = vector <vector<Int>>(e);
         }
 
+        for (i = 0; i < e; i++) mod *= p;
         for (i = 0; i < len; i++) sequence[i] %= mod;
-        for (i = 1; i <= e; i++) POW[i] = (long long)POW[i - 1] * p % mod;
+        for (i = 1; i <= e; i++) POW[i] = POW[i - 1] * p % mod;
         for (i = 0; i < e; i++){
-            T[i] = (long long)sequence[0] * POW[i] % mod;
-            A[0][i] = {POW[i]}, A[1][i] = {POW[i]};
-            B[0][i] = {0}, B[1][i] = {(int)((long long)sequence[0] * POW[i] % mod)};
+            T[i] = mul(sequence[0], POW[i], mod);
+            A[0][i] = {(Int)POW[i]}, A[1][i] = {(Int)POW[i]};
+            B[0][i] = {0}, B[1][i] = {mul(sequence[0], POW[i], mod)};
             for (U[i] = 0; T[i] && T[i] % p == 0; T[i] /= p, U[i]++) {}
             if (!T[i]) T[i] = 1, U[i] = e;
         }
@@ -458,7 +546,7 @@ struct LinearRecurrence{
             A[0] = A[1], B[0] = B[1];
             for (l = 0; l < e; l++){
                 for (d = 0, i = min(k, (int)A[0][l].size() - 1); i >= 0; i--){
-                    d = (d + A[0][l][i] * (long long)sequence[k - i]) % mod;
+                    d = (d + (W)A[0][l][i] * sequence[k - i] % mod) % mod;
                 }
 
                 if (!d) T[l] = 1, U[l] = e;
@@ -472,8 +560,8 @@ struct LinearRecurrence{
                     }
                     else{
                         m = k - R[j];
-                        c = (long long)T[l] * nt::mod_inverse(TO[j], mod) % mod;
-                        c = (long long)c * (long long)POW[U[l] - UO[j]] % mod;
+                        c = nt::mul(T[l], nt::mod_inverse(TO[j], mod), mod);
+                        c = nt::mul(c, POW[U[l] - UO[j]], mod);
                         update(A[1][l], A[2][j], m, c);
                         update(B[1][l], B[2][j], m, c);
                     }
@@ -484,14 +572,14 @@ struct LinearRecurrence{
         return A[1][0];
     }
 
-    vector <int> berlekamp_massey(vector <int> sequence, long long mod){
+    vector <Int> berlekamp_massey(vector <Int> sequence, long long mod){
         int n = sequence.size();
-        vector <int> T, B(n + 1, 0), C(n + 1, 0);
+        vector <Int> T, B(n + 1, 0), C(n + 1, 0);
         reverse(sequence.begin(), sequence.end());
 
         C[0] = 1, B[0] = 1;
-        int i, j, d, l = 0, m = 1, deg = 0;
-        unsigned long long x, b = nt::mod_inverse(1, mod);
+        int i, j, l = 0, m = 1, deg = 0;
+        long long d, x, b = nt::mod_inverse(1, mod);
 
         for (i = 0; i < n; i++){
             d = sequence[n - i - 1];
@@ -499,10 +587,10 @@ struct LinearRecurrence{
             if (d == 0) m++;
             else{
                 if (l * 2 <= i) T = C, T.resize(l + 1);
-                x = (b * (mod - d) % mod + mod) % mod;
+                x = nt::mul(b, mod - d, mod);
 
                 for (j = 0, m++; j <= deg; j++){
-                    C[m + j - 1] = (C[m + j - 1] + x * B[j]) % mod;
+                    C[m + j - 1] = (C[m + j - 1] + (W)x * B[j]) % mod;
                 }
 
                 if (l * 2 <= i){
@@ -517,29 +605,213 @@ struct LinearRecurrence{
         return C;
     }
 
-    vector <int> decompose(vector <int> sequence, int mod){
-        int i, j, e, n, p, m, k = 0;
+    /***
+     * Polynomial helpers for the half-GCD and for nth_terms(n, k), coefficients are modulo mod
+     * Polynomials never have trailing zeros, so the zero polynomial is empty and has degree -1
+     *
+    ***/
+    typedef array<array<vector<Int>, 2>, 2> Matrix;
+
+    int degree(const vector <Int>& a){
+        return (int)a.size() - 1;
+    }
+
+    void normalize(vector <Int>& a){
+        while (a.size() && !a.back()) a.pop_back();
+    }
+
+    vector <Int> add(const vector <Int>& a, const vector <Int>& b){
+        vector <Int> res(max(a.size(), b.size()), 0);
+        for (int i = 0; i < (int)res.size(); i++){
+            long long x = (i < (int)a.size() ? a[i] : 0) + (long long)(i < (int)b.size() ? b[i] : 0);
+            res[i] = x >= mod ? x - mod : x;
+        }
+        normalize(res);
+        return res;
+    }
+
+    vector <Int> product(vector <Int> a, vector <Int> b){
+        if (a.empty() || b.empty()) return {};
+        auto res = multiply(a, b);
+        normalize(res);
+        return res;
+    }
+
+    vector <Int> negate(vector <Int> a){
+        for (auto&& x: a) x = x ? mod - x : 0;
+        return a;
+    }
+
+    /// a / x^k, dropping the k lowest terms
+    vector <Int> shift_down(const vector <Int>& a, int k){
+        return vector <Int>(a.begin() + min(max(k, 0), (int)a.size()), a.end());
+    }
+
+    /// First n terms of 1 / a with Newton's iteration, a[0] must be invertible
+    vector <Int> inverse_series(const vector <Int>& a, int n){
+        vector <Int> res(1, nt::mod_inverse(a[0], mod));
+        for (int len = 1; len < n;){
+            len = min(2 * len, n);
+            vector <Int> f(a.begin(), a.begin() + min(len, (int)a.size()));
+            auto g = multiply(f, res);
+            g.resize(len, 0);
+            g = negate(g), g[0] = (g[0] + 2LL) % mod;
+
+            res = multiply(res, g);
+            res.resize(len, 0);
+        }
+        return res;
+    }
+
+    /// Quotient and remainder of a / b, long division for short quotients and a reversed inverse series otherwise
+    pair <vector<Int>, vector<Int>> divide(vector <Int> a, const vector <Int>& b){
+        int i, j, n = a.size(), m = b.size();
+        if (n < m) return {{}, a};
+
+        vector <Int> quot(n - m + 1);
+        if (n - m < 64 || m <= 64){
+            long long inv = nt::mod_inverse(b.back(), mod);
+            for (i = n - m; i >= 0; i--){
+                long long c = quot[i] = mul(a[i + m - 1], inv, mod);
+                for (j = 0; j < m && c; j++){
+                    a[i + j] = (a[i + j] + mod - mul(c, b[j], mod)) % mod;
+                }
+            }
+            a.resize(m - 1);
+            normalize(a), normalize(quot);
+            return {quot, a};
+        }
+
+        vector <Int> ra(a.rbegin(), a.rbegin() + (n - m + 1)), rb(b.rbegin(), b.rend());
+        auto inv = inverse_series(rb, n - m + 1);
+        quot = multiply(ra, inv);
+        quot.resize(n - m + 1);
+        reverse(quot.begin(), quot.end());
+        normalize(quot);
+        return {quot, add(a, negate(product(quot, b)))};
+    }
+
+    Matrix multiply(const Matrix& A, const Matrix& B){
+        Matrix C;
+        for (int i = 0; i < 2; i++){
+            for (int j = 0; j < 2; j++){
+                C[i][j] = add(product(A[i][0], B[0][j]), product(A[i][1], B[1][j]));
+            }
+        }
+        return C;
+    }
+
+    /// (a, b) = M (a, b)
+    void apply(const Matrix& M, vector <Int>& a, vector <Int>& b){
+        auto c = add(product(M[0][0], a), product(M[0][1], b));
+        b = add(product(M[1][0], a), product(M[1][1], b));
+        a = c;
+    }
+
+    /// One step of the Euclidean algorithm, (a, b) = (b, a mod b) and M = [[0, 1], [1, -(a / b)]] M
+    void euclid_step(Matrix& M, vector <Int>& a, vector <Int>& b){
+        auto qr = divide(a, b);
+        a.swap(b), b = qr.second;
+        Matrix step;
+        step[0][1] = step[1][0] = {1}, step[1][1] = negate(qr.first);
+        M = multiply(step, M);
+    }
+
+    /***
+     * Half-GCD, for deg a > deg b returns the matrix M of Euclidean steps such that (a', b') = M (a, b)
+     * are the first two consecutive remainders with deg a' >= m > deg b', where m = ceil(deg a / 2)
+     * The remainders only depend on the high halves of a and b until then, which gives O(M(k) log k)
+     *
+    ***/
+    Matrix half_gcd(vector <Int> a, vector <Int> b){
+        int m = (degree(a) + 1) / 2;
+        Matrix M;
+        M[0][0] = M[1][1] = {1};
+        if (degree(b) < m) return M;
+
+        if (degree(a) <= 64){
+            while (degree(b) >= m) euclid_step(M, a, b);
+            return M;
+        }
+
+        M = half_gcd(shift_down(a, m), shift_down(b, m));
+        apply(M, a, b);
+        if (degree(b) < m) return M;
+
+        euclid_step(M, a, b);
+        if (degree(b) < m) return M;
+
+        int k = 2 * m - degree(a);
+        return multiply(half_gcd(shift_down(a, k), shift_down(b, k)), M);
+    }
+
+    /***
+     * Berlekamp-Massey through the half-GCD of x^N and S(x) = s_0 + s_1 x + ... + s_(N-1) x^(N-1), for prime mod only
+     * The first remainder R = V S mod x^N with deg R < N / 2 gives the connection polynomial V / V(0)
+     * of length max(deg V, deg R + 1), same as the quadratic method but in O(N log^2 N)
+     *
+     * Returns an empty vector if V(0) = 0, which can only happen if the sequence has no recurrence of length <= N / 2
+     *
+    ***/
+    vector <Int> fast_berlekamp_massey(const vector <Int>& sequence){
+        int i, n = sequence.size();
+        vector <Int> a(n + 1, 0), b = sequence;
+        a[n] = 1 % mod;
+        normalize(b);
+
+        auto M = half_gcd(a, b);
+        auto V = M[1][1], R = product(V, b);
+        if (V.empty() || !V[0]) return {};
+
+        R.resize(min((int)R.size(), n));
+        normalize(R);
+
+        int l = max(degree(V), degree(R) + 1);
+        long long inv = nt::mod_inverse(V[0], mod);
+        V.resize(l + 1, 0);
+        for (i = 0; i <= l; i++) V[i] = mul(V[i], inv, mod);
+        return V;
+    }
+
+    /***
+     * Solves every prime power factor of mod separately, each on its own thread, and combines them with CRT
+     * Prime mods use the half-GCD Berlekamp-Massey on long sequences, the quadratic one is faster below HALF_GCD_LIMIT terms
+     * The limit is higher for 64 bit values, since their quadratic method is slower but their products need more primes
+     *
+    ***/
+    static const int HALF_GCD_LIMIT = is_same<Int, int>::value ? 6000 : 12000;
+
+    vector <Int> decompose(vector <Int> sequence, long long mod){
+        int i, j, e, n, k = 0;
+        long long p;
         auto factors = nt::get_factors(mod);
         n = factors.size();
 
         if (n == 1 && factors.begin()->second == 1){
+            if ((int)sequence.size() >= HALF_GCD_LIMIT){
+                auto res = fast_berlekamp_massey(sequence);
+                if (res.size()) return res;
+            }
             return berlekamp_massey(sequence, mod);
         }
 
-        vector <int> v, mods, vals(n);
-        vector <vector<int>> coeffs;
+        vector <long long> mods, vals(n);
+        vector <vector<Int>> coeffs(n);
+        vector <thread> threads;
 
         for (auto it: factors){
             tie(p, e) = it;
-            m = powl(p, e) + 0.5;
+            long long m = 1;
+            for (i = 0; i < e; i++) m *= p;
             mods.push_back(m);
 
-            v = reeds_sloane(sequence, p, e);
-            k = max(k, (int)v.size());
-            coeffs.push_back(v);
+            int idx = threads.size();
+            threads.emplace_back([&, p, e, idx](){ coeffs[idx] = reeds_sloane(sequence, p, e); });
         }
+        for (auto&& t: threads) t.join();
+        for (auto&& v: coeffs) k = max(k, (int)v.size());
 
-        vector <int> res(k);
+        vector <Int> res(k);
         for (i = 0; i < k; i++){
             for (j = 0; j < n; j++){
                 vals[j] = i < (int)coeffs[j].size() ? coeffs[j][i] : 0;
@@ -551,36 +823,161 @@ struct LinearRecurrence{
         return res;
     }
 
+    /// a * b modulo mod, directly for short inputs where the transform is not worth it
+    vector <Int> multiply(vector <Int>& a, vector <Int>& b){
+        if (min(a.size(), b.size()) > 64) return ntt::mod_multiply(a, b, mod);
+
+        vector <Int> res(a.size() + b.size() - 1);
+        for (int k = 0; k < (int)res.size(); k++){
+            W x = 0;
+            for (int i = max(0, k - (int)b.size() + 1); i <= min(k, (int)a.size() - 1); i++){
+                x += (W)a[i] * b[k - i];
+                if (x >> (8 * sizeof(W) - 1)) x %= mod;
+            }
+            res[k] = x % mod;
+        }
+        return res;
+    }
+
+    /// Builds P, Q and the first levels of the chain for Bostan-Mori
+    void build_fraction(int levels){
+        int i, d = recurrence.size();
+        if (chain.empty()){
+            /// Q(x) = x^d * C(1 / x) where C(x) = x^d + recurrence[d - 1] x^(d - 1) + ... is the characteristic polynomial
+            vector <Int> q(d + 1, 0), a(raw_base_sequence.begin(), raw_base_sequence.begin() + d);
+            q[0] = 1 % mod;
+            for (i = 0; i < d; i++) q[d - i] = recurrence[i];
+
+            numerator = multiply(a, q);
+            numerator.resize(d);
+            for (i = 1; i <= d; i += 2) q[i] = q[i] ? mod - q[i] : 0;
+            chain.push_back(q);
+        }
+
+        while ((int)chain.size() < levels){
+            vector <Int> q = chain.back(), r = q;
+            for (i = 1; i <= d; i += 2) r[i] = r[i] ? mod - r[i] : 0;
+
+            auto v = multiply(q, r);
+            for (i = 0; i <= d; i++) q[i] = v[2 * i];
+            for (i = 1; i <= d; i += 2) q[i] = q[i] ? mod - q[i] : 0;
+            chain.push_back(q);
+        }
+    }
+
+    /***
+     * Bostan-Mori, the n'th term is [x^n] P(x) / Q(x) = [x^(n / 2)] U_n%2(x) / Q_1(x) where P(x) * Q(-x) = U_0(x^2) + x U_1(x^2)
+     * Each halving step costs a single multiplication, since the chain of denominators does not depend on n
+     *
+    ***/
+    Int bostan_mori(long long n){
+        int t, i, j, k, d = recurrence.size();
+        vector <Int> p = numerator, u(d);
+
+        for (t = 0; n > 0; t++, n >>= 1){
+            if (d > 64){
+                u = multiply(p, chain[t]);
+                for (i = 0; i < d; i++) p[i] = u[2 * i + (n & 1)];
+                continue;
+            }
+
+            /// Short recurrences only compute the half of the product that is kept
+            const vector <Int>& q = chain[t];
+            for (i = 0; i < d; i++){
+                W x = 0;
+                for (k = 2 * i + (n & 1), j = max(0, k - d); j <= min(k, d - 1); j++){
+                    x += (W)p[j] * q[k - j];
+                    if (x >> (8 * sizeof(W) - 1)) x %= mod;
+                }
+                u[i] = x % mod;
+            }
+            p.swap(u);
+        }
+        return p[0];
+    }
+
+    /***
+     * Calculates the n'th term for every n in ns, sharing the chain of denominators between the queries
+     * Costs O(M(k) log n) per query, where M(k) is the cost of multiplying two polynomials of the recurrence degree k
+     *
+    ***/
+    vector <Int> nth_terms(const vector <long long>& ns){
+        vector <Int> res;
+        if (mod == 1) return vector <Int>(ns.size(), 0);
+
+        long long hi = 0;
+        for (auto n: ns) hi = max(hi, n);
+        if (recurrence.size()) build_fraction(64 - __builtin_clzll(hi | 1));
+
+        for (auto n: ns){
+            if (n < (int)base_sequence.size()) res.push_back(base_sequence[n]);
+            else res.push_back(recurrence.empty() ? 0 : bostan_mori(n));
+        }
+        return res;
+    }
+
+    /// x^n modulo the monic polynomial c, the inverse series used by every reduction is computed once
+    vector <Int> power(long long n, const vector <Int>& c){
+        int d = degree(c);
+        if (d == 0) return {};
+
+        vector <Int> rc(c.rbegin(), c.rend()), res = {1}, inv = inverse_series(rc, d);
+        auto reduce = [&](vector <Int> r){
+            int len = (int)r.size() - d;
+            if (len <= 0) return r;
+
+            vector <Int> rr(r.rbegin(), r.rbegin() + len), iv(inv.begin(), inv.begin() + len);
+            auto quot = multiply(rr, iv);
+            quot.resize(len);
+            reverse(quot.begin(), quot.end());
+            normalize(quot);
+
+            r = add(r, negate(product(quot, c)));
+            r.resize(min((int)r.size(), d));
+            normalize(r);
+            return r;
+        };
+
+        for (int l = 63 - __builtin_clzll(n); l >= 0; l--){
+            res = reduce(product(res, res));
+            if (n & (1LL << l)) res.insert(res.begin(), 0), res = reduce(res);
+        }
+        return res;
+    }
+
     /***
      * Calculates the n'th, n+1'th, ... , n+k-1'th term of the recurrence
      * k must be less than the recurrence degree
+     *
+     * Computes x^n modulo the characteristic polynomial, so the whole window costs about as much as a single term
+     * For separate terms, nth_term() and nth_terms(ns) with Bostan-Mori are faster
+     *
     ***/
 
-    vector <int> nth_terms(long long n, int k){
-        vector <int> u = recurrence, v, res;
+    vector <Int> nth_terms(long long n, int k){
+        vector <Int> u = recurrence, v, res;
 
-        if (mod == 1) return vector <int> (k, 0);
+        if (mod == 1) return vector <Int> (k, 0);
         if ((n + k - 1) < (int)base_sequence.size()){
             for (int i = 0; i < k; i++) res.push_back(base_sequence[(int)n + i]);
             return res;
         }
 
         u.push_back(1);
-        auto p = Polynomial(u);
-        p = Polynomial({0, 1}).power(p, n);
+        auto p = power(n, u);
 
         for (int i = 0; i < min((int)p.size(), (int)recurrence.size()); i++){
-            v.push_back(p.coefficient[i]);
+            v.push_back(p[i]);
         }
         int len = min(recurrence.size(), min(v.size(), base_sequence.size()));
-        if (!len) return vector <int> (k, 0);
+        if (!len) return vector <Int> (k, 0);
 
         assert(len >= k);
         for (int j = 0; j < k; j++){
             long long val = 0;
             for (int i = 0; i < len; i++){
                 assert((i + j) < (int)raw_base_sequence.size());
-                val = (val + (long long)v[i] * raw_base_sequence[i + j]) % mod;
+                val = (val + mul(v[i], raw_base_sequence[i + j], mod)) % mod;
             }
             res.push_back(val);
         }
@@ -588,22 +985,22 @@ struct LinearRecurrence{
         return res;
     }
 
-    int nth_term(long long n){
-        auto v = nth_terms(n, 1);
+    Int nth_term(long long n){
+        auto v = nth_terms(vector <long long>(1, n));
         return v[0];
     }
 };
 
 int main(){
     int i, j, k, v, mod;
-    LinearRecurrence lr;
+    LinearRecurrence<int> lr;
     vector <int> sequence, recurrence;
 
     /// recurrence given, f(x) = f(x - 3) + 2*f(x - 2) + 4*f(x-1), x > 2
     recurrence = {1, 2, 4};
     sequence = {0, 1, 1, 6, 27, 121}, mod = 100;
 
-    lr = LinearRecurrence(sequence, mod, recurrence);
+    lr = LinearRecurrence<int>(sequence, mod, recurrence);
     assert(lr.nth_term(6) == 44);
     assert(lr.nth_term(9) == 90);
     assert(lr.nth_term(10) == 83);
@@ -613,22 +1010,42 @@ int main(){
     recurrence = {1, 1};
     sequence = {0, 1, 1, 2}, mod = 1000000007;
 
-    lr = LinearRecurrence(sequence, mod, recurrence);
+    lr = LinearRecurrence<int>(sequence, mod, recurrence);
     assert(lr.nth_term(8) == 21);
     assert(lr.nth_term(9) == 34);
     assert(lr.nth_term(10) == 55);
     assert(lr.nth_term(1e18) == 209783453);
 
     /// alternatively, the recurrence of degree k can be derived from the first 2k terms
-    lr = LinearRecurrence(sequence, mod);
+    lr = LinearRecurrence<int>(sequence, mod);
     assert(lr.nth_term(8) == 21);
     assert(lr.nth_term(9) == 34);
     assert(lr.nth_term(10) == 55);
     assert(lr.nth_term(1e18) == 209783453);
 
+    /// composite mods are solved separately for every prime power factor, here 10^6 = 2^6 * 5^6
+    lr = LinearRecurrence<int>({0, 1, 1, 2, 3, 5, 8, 13}, 1000000);
+    assert(lr.nth_term(30) == 832040);
+    assert(lr.nth_term(1e18) == 546875);
+
+    /// mods up to 2^62 need 64 bit values, products are still exact
+    LinearRecurrence<long long> lr1({0, 1, 1, 2}, (1LL << 61) - 1), lr2({0, 1, 1, 2}, 1LL << 62);
+    assert(lr1.nth_term(90) == 574224185157122169LL);
+    assert(lr1.nth_term(1e18) == 1024960830501646393LL);
+
+    /// every instance keeps its own mod, so they can be mixed freely
+    assert(lr2.nth_term(90) == 2880067194370816120LL);
+    assert(lr2.nth_term(1e18) == 3919126379787055675LL);
+    assert(lr1.nth_term(1e18) == 1024960830501646393LL);
+
+    lr = LinearRecurrence<int>(sequence, mod);
+
     /// faster than calculating lr.nth_term(8) and lr.nth_term(9) separately
     assert(lr.nth_terms(8, 2) == vector<int>({21, 34}));
 
+    /// many separate queries at once, sharing the work that does not depend on n
+    assert(lr.nth_terms(vector<long long>({10, 3, 1000000000000000000LL, 8})) == vector<int>({55, 2, 209783453, 21}));
+
     /***
      *
      * Test performance on a recurrence with large degree
@@ -651,10 +1068,10 @@ int main(){
     }
 
     clock_t start = clock();
-    lr = LinearRecurrence(sequence, mod);
+    lr = LinearRecurrence<int>(sequence, mod);
     assert((int)lr.recurrence.size() == k);
     assert(lr.nth_term(1000000000000000000LL) == 255380209);
 
-    fprintf(stderr, "\nTime taken = %0.5f\n", (clock() - start) / (double)CLOCKS_PER_SEC);  /// Time taken = 0.44215
+    fprintf(stderr, "\nTime taken = %0.5f\n", (clock() - start) / (double)CLOCKS_PER_SEC);  /// Time taken = 0.37509
     return 0;
 }
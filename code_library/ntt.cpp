@@ -0,0 +1,418 @@
+/***
+ * Number Theoretic Transformation
+ *
+ * Exact polynomial multiplication using modular arithmetic instead of complex numbers
+ * No rounding or precision issues unlike fft.cpp, and several times faster for large inputs
+ *
+ * Butterflies use Montgomery multiplication with lazy reduction (values are kept in [0, 2 * mod))
+ * Roots are precomputed for every power of two length only once per thread and reused afterwards
+ * Every thread gets its own engines, so the exposed methods can be called concurrently from different threads
+ * Compile with -pthread in that case on older toolchains
+ *
+ * mod_multiply takes the direct path with a single NTT prime if mod is NTT-friendly (998244353 for example)
+ * Any other modulus below 2^31 is handled with three NTT primes and combined with the chinese remainder theorem
+ * multiply also uses the three prime path and returns the exact result, even for negative values
+ *
+ * Complexity:
+ *   - O(n log n) for all exposed methods
+ *   - Roughly 3x the cost of a single prime for the three prime path
+ *
+ * Limits:
+ *   - Length of the product must not exceed 2^23 for 998244353 and 2^24 for the three prime path
+ *   - Absolute value of every coefficient in the exact product (or the folded convolution) must be less than 2^63
+ *     The three primes could recover up to 2^84, but the result is returned as long long
+ *
+***/
+
+#include <bits/stdc++.h>
+
+using namespace std;
+
+namespace ntt{
+    namespace{ /// Anonymous namespace to wrap internally used variables and methods
+        const uint32_t P1 = 754974721, P2 = 167772161, P3 = 469762049;
+
+        /// Montgomery form with R = 2^32, mod must be odd and less than 2^30
+        struct Montgomery{
+            uint32_t mod, mod2, inv, r2;
+
+            Montgomery(uint32_t mod=1) : mod(mod), mod2(mod * 2){
+                inv = mod;
+                for (int i = 0; i < 5; i++) inv *= 2 - mod * inv;
+                inv = -inv;
+                r2 = (-(uint64_t)mod) % mod;
+            }
+
+            /// x must be less than mod * 2^32, result is in [0, 2 * mod)
+            inline uint32_t reduce(uint64_t x) const{
+                return (x + (uint64_t)((uint32_t)x * inv) * mod) >> 32;
+            }
+
+            inline uint32_t mul(uint32_t a, uint32_t b) const{
+                return reduce((uint64_t)a * b);
+            }
+
+            inline uint32_t add(uint32_t a, uint32_t b) const{
+                a += b;
+                return a >= mod2 ? a - mod2 : a;
+            }
+
+            inline uint32_t sub(uint32_t a, uint32_t b) const{
+                a += mod2 - b;
+                return a >= mod2 ? a - mod2 : a;
+            }
+
+            inline uint32_t normalize(uint32_t x) const{
+                return x >= mod ? x - mod : x;
+            }
+
+            inline uint32_t to_mont(uint32_t x) const{
+                return normalize(mul(x, r2));
+            }
+        };
+
+        uint64_t expo(uint64_t x, uint64_t n, uint64_t mod){
+            uint64_t res = 1;
+            for (x %= mod; n; n >>= 1, x = x * x % mod){
+                if (n & 1) res = res * x % mod;
+            }
+            return res;
+        }
+
+        int get_bit(int len){
+            return 32 - __builtin_clz(len) - (__builtin_popcount(len) == 1);
+        }
+
+        /// Transforms are done in place, forward leaves the result in bit-reversed order and inverse takes it back
+        struct NTT{
+            Montgomery mt;
+            uint32_t mod, root;
+            int max_len;
+            vector<uint32_t> rt, irt;  /// rt[h + j] = w^j where w is the principal (2h)'th root of unity
+
+            NTT(uint32_t mod=0) : mt(mod | 1), mod(mod), root(0), max_len(1), rt(2, 0), irt(2, 0){
+                if (!mod) return;
+                while ((mod - 1) % (2 * max_len) == 0) max_len *= 2;
+
+                vector<uint32_t> factors;
+                uint32_t d, x = mod - 1;
+                for (d = 2; d * d <= x; d++){
+                    if (x % d == 0) factors.push_back(d);
+                    while (x % d == 0) x /= d;
+                }
+                if (x > 1) factors.push_back(x);
+
+                for (root = 2; ; root++){
+                    bool flag = true;
+                    for (auto f: factors) flag = flag && expo(root, (mod - 1) / f, mod) != 1;
+                    if (flag) break;
+                }
+
+                rt[1] = irt[1] = mt.to_mont(1);
+            }
+
+            void build(int len){
+                assert(len <= max_len);
+
+                for (int h = rt.size() >> 1; 2 * h < len; h <<= 1){
+                    rt.resize(4 * h), irt.resize(4 * h);
+                    uint32_t w = mt.to_mont(expo(root, (mod - 1) / (4 * h), mod));
+                    uint32_t iw = mt.to_mont(expo(expo(root, mod - 2, mod), (mod - 1) / (4 * h), mod));
+
+                    for (int j = 0; j < 2 * h; j++){
+                        rt[2 * h + j] = j & 1 ? mt.normalize(mt.mul(rt[h + (j >> 1)], w)) : rt[h + (j >> 1)];
+                        irt[2 * h + j] = j & 1 ? mt.normalize(mt.mul(irt[h + (j >> 1)], iw)) : irt[h + (j >> 1)];
+                    }
+                }
+            }
+
+            void forward(uint32_t* ar, int len){
+                for (int h = len >> 1; h >= 1; h >>= 1){
+                    const uint32_t* w = &rt[h];
+                    for (int i = 0; i < len; i += 2 * h){
+                        uint32_t *a = ar + i, *b = ar + i + h;
+                        for (int j = 0; j < h; j++){
+                            uint32_t x = a[j], y = b[j];
+                            a[j] = mt.add(x, y);
+                            b[j] = mt.mul(x + mt.mod2 - y, w[j]);
+                        }
+                    }
+                }
+            }
+
+            void inverse(uint32_t* ar, int len){
+                for (int h = 1; h < len; h <<= 1){
+                    const uint32_t* w = &irt[h];
+                    for (int i = 0; i < len; i += 2 * h){
+                        uint32_t *a = ar + i, *b = ar + i + h;
+                        for (int j = 0; j < h; j++){
+                            uint32_t x = a[j], y = mt.mul(b[j], w[j]);
+                            a[j] = mt.add(x, y);
+                            b[j] = mt.sub(x, y);
+                        }
+                    }
+                }
+            }
+
+            /// Returns the product of v1 and v2 modulo this prime, truncated to p_len values
+            vector<uint32_t> multiply(const vector<long long>& v1, const vector<long long>& v2, int p_len, bool is_equal){
+                int i, len = 1 << get_bit(p_len);
+                build(len);
+
+                vector<uint32_t> f(len, 0), g;
+                for (i = 0; i < (int)v1.size(); i++) f[i] = (v1[i] % mod + mod) % mod;
+                forward(f.data(), len);
+
+                if (is_equal) g = f;
+                else{
+                    g.assign(len, 0);
+                    for (i = 0; i < (int)v2.size(); i++) g[i] = (v2[i] % mod + mod) % mod;
+                    forward(g.data(), len);
+                }
+
+                /// The pointwise product introduces a factor of 1/R, which is cancelled along with 1/len at the end
+                for (i = 0; i < len; i++) f[i] = mt.mul(f[i], g[i]);
+                inverse(f.data(), len);
+
+                uint32_t scale = mt.to_mont(mt.to_mont(expo(len, mod - 2, mod)));
+                f.resize(p_len);
+                for (i = 0; i < p_len; i++) f[i] = mt.normalize(mt.mul(f[i], scale));
+                return f;
+            }
+        };
+
+        /// One set of engines per thread, as they cache roots and are extended on demand
+        thread_local map<uint32_t, NTT> engines;
+
+        NTT& get_engine(uint32_t mod){
+            auto it = engines.find(mod);
+            if (it == engines.end()) it = engines.emplace(mod, NTT(mod)).first;
+            return it->second;
+        }
+
+        bool is_ntt_prime(int mod, int p_len){
+            if (mod < 3 || mod >= (1 << 30) || !(mod & 1) || ((mod - 1) & ((1 << get_bit(p_len)) - 1))) return false;
+            for (int d = 3; d * d <= mod; d += 2){
+                if (mod % d == 0) return false;
+            }
+            return true;
+        }
+
+        int trim(const vector<long long>& v){
+            int n = v.size();
+            while (n > 1 && v[n - 1] == 0) n--;
+            return n;
+        }
+
+        /// Garner's algorithm, the value of x modulo P1 * P2 * P3 is r1 + x2 * P1 + x3 * P1 * P2
+        inline void garner(uint32_t r1, uint32_t r2, uint32_t r3, uint64_t& x2, uint64_t& x3){
+            static const uint64_t inv_1_2 = expo(P1, P2 - 2, P2), inv_1_3 = expo(P1, P3 - 2, P3);
+            static const uint64_t inv_2_3 = expo(P2, P3 - 2, P3);
+
+            x2 = (r2 + P2 - r1 % P2) * inv_1_2 % P2;
+            x3 = ((r3 + P3 - r1 % P3) * inv_1_3 % P3 + P3 - x2 % P3) * inv_2_3 % P3;
+        }
+
+        /// Wraps res around onto its first n values, reducing modulo mod if it is positive
+        void fold(vector<long long>& res, int n, int mod){
+            for (int i = n; i < (int)res.size(); i++){
+                res[i - n] += res[i];
+                if (mod && res[i - n] >= mod) res[i - n] -= mod;
+            }
+            res.resize(n);
+        }
+    }
+
+    /***
+     * Same as multiply(v1, v2), only values are calculated modulo mod
+     * mod must be a positive integer less than 2^31, values can be negative
+     *
+    ***/
+    vector<long long> mod_multiply(const vector<long long>& v1, const vector<long long>& v2, int mod){
+        assert(mod > 0);
+
+        int i, n = trim(v1), m = trim(v2), p_len = v1.size() + v2.size() - 1;
+        vector<long long> res(p_len, 0);
+        if (mod == 1) return res;
+
+        vector<long long> a(v1.begin(), v1.begin() + n), b(v2.begin(), v2.begin() + m);
+        bool is_equal = (a == b);
+
+        if (is_ntt_prime(mod, n + m - 1)){
+            auto f = get_engine(mod).multiply(a, b, n + m - 1, is_equal);
+            for (i = 0; i < n + m - 1; i++) res[i] = f[i];
+            return res;
+        }
+
+        for (auto &&x: a) x = (x % mod + mod) % mod;
+        for (auto &&x: b) x = (x % mod + mod) % mod;
+
+        auto f1 = get_engine(P1).multiply(a, b, n + m - 1, is_equal);
+        auto f2 = get_engine(P2).multiply(a, b, n + m - 1, is_equal);
+        auto f3 = get_engine(P3).multiply(a, b, n + m - 1, is_equal);
+
+        uint64_t x2, x3, p1 = P1 % mod, p12 = (uint64_t)P1 * P2 % mod;
+        for (i = 0; i < n + m - 1; i++){
+            garner(f1[i], f2[i], f3[i], x2, x3);
+            res[i] = (f1[i] + x2 * p1 % mod + x3 * p12 % mod) % mod;
+        }
+        return res;
+    }
+
+    /***
+     * Multiplies two polynomials and returns the exact result in a vector
+     * Values can be negative, see the limits at the top
+     *
+     * vector multiply(vector v1, vector v2):
+     *     n = v1.size()
+     *     m = v2.size()
+     *     vector res = vector(n + m - 1, 0)
+     *
+     *     for (i = 0; i < n; i++)
+     *         for (j = 0; j < m; j++)
+     *             res[i + j] += v1[i] * v2[j]
+     *
+     *     return res
+     *
+    ***/
+    vector<long long> multiply(const vector<long long>& v1, const vector<long long>& v2){
+        int i, n = trim(v1), m = trim(v2), p_len = v1.size() + v2.size() - 1;
+
+        vector<long long> a(v1.begin(), v1.begin() + n), b(v2.begin(), v2.begin() + m);
+        bool is_equal = (a == b);
+
+        auto f1 = get_engine(P1).multiply(a, b, n + m - 1, is_equal);
+        auto f2 = get_engine(P2).multiply(a, b, n + m - 1, is_equal);
+        auto f3 = get_engine(P3).multiply(a, b, n + m - 1, is_equal);
+
+        const __int128 p12 = (__int128)P1 * P2, p123 = p12 * P3;
+
+        uint64_t x2, x3;
+        vector<long long> res(p_len, 0);
+        for (i = 0; i < n + m - 1; i++){
+            garner(f1[i], f2[i], f3[i], x2, x3);
+            __int128 x = f1[i] + (__int128)x2 * P1 + x3 * p12;
+            res[i] = x > p123 / 2 ? x - p123 : x;
+        }
+        return res;
+    }
+
+    /***
+     * Same as multiply(v, v)
+     *
+    ***/
+    vector<long long> square(const vector<long long>& v){
+        return multiply(v, v);
+    }
+
+    /***
+     * Computes the circular convolution of v1 and v2 and returns the n values, see fft.cpp for the details
+     * The vectors must be of the same size, if not normalize and pad with zeros
+     *
+    ***/
+    vector<long long> convolution(const vector<long long>& v1, const vector<long long>& v2){
+        assert(v1.size() == v2.size());
+
+        auto res = multiply(v1, v2);
+        fold(res, v1.size(), 0);
+        return res;
+    }
+
+    /***
+     * Same as convolution(v1, v2), only values are calculated modulo mod
+     *
+    ***/
+    vector<long long> mod_convolution(const vector<long long>& v1, const vector<long long>& v2, int mod){
+        assert(v1.size() == v2.size());
+
+        auto res = mod_multiply(v1, v2, mod);
+        fold(res, v1.size(), mod);
+        return res;
+    }
+}
+
+int main(){
+    using namespace ntt;
+
+    vector<long long> v1, v2, expected_result;
+
+    v1 = {5, 1, 2, 6, 9, 8};
+    v2 = {3, 9, 0, 2};
+    assert(multiply(v1, v2) == vector<long long>({15, 48, 15, 46, 83, 109, 84, 18, 16}));
+
+    int mod = 14;
+    assert(mod_multiply(v1, v2, mod) == vector<long long>({1, 6, 1, 4, 13, 11, 0, 4, 2}));
+
+    for (auto && x: v1) x = (1 << 30) - x;
+    for (auto && x: v2) x = (1 << 30) - x;
+    expected_result = {1152921496016912399, 2305842989886341168, 3458764492345704463, 4611685988362616878, 4611685984067649619, 4611685976551456877, 3458764477313318996, 2305842988812599314, 1152921493869428752};
+
+    assert(multiply(v1, v2) == expected_result);  /// exact, unlike fft::multiply
+
+    for (auto && x: v1) x = -x;
+    for (auto && x: expected_result) x = -x;
+    assert(multiply(v1, v2) == expected_result);
+
+    /// Coefficients at the edges of the long long range
+    assert(multiply({3037000499LL, -3037000499LL}, {3037000499LL}) == vector<long long>({9223372030926249001LL, -9223372030926249001LL}));
+    assert(multiply({-(1LL << 62), 1LL << 61}, {2, 2}) == vector<long long>({LLONG_MIN, -(1LL << 62), 1LL << 62}));
+
+    v1 = {1, 2, 3, 4};
+    v2 = {1, 0, 0, 2};
+    assert(convolution(v1, v2) == vector<long long>({5, 8, 11, 6}));
+
+    mod = 2;
+    assert(mod_convolution(v1, v2, mod) == vector<long long>({1, 0, 1, 0}));
+
+    /// Cross-check both the direct and the three prime paths against the naive multiplication
+    mt19937 rng(0);
+    for (int mod: {998244353, 1000000007, 2147483647, 65536, 1}){
+        for (int n = 1; n <= 64; n++){
+            v1.resize(n), v2.resize(rng() % 64 + 1);
+            for (auto && x: v1) x = (long long)rng() - (1LL << 31);
+            for (auto && x: v2) x = (long long)rng() - (1LL << 31);
+
+            expected_result.assign(v1.size() + v2.size() - 1, 0);
+            for (int i = 0; i < (int)v1.size(); i++){
+                for (int j = 0; j < (int)v2.size(); j++){
+                    long long x = ((v1[i] % mod + mod) % mod) * ((v2[j] % mod + mod) % mod) % mod;
+                    expected_result[i + j] = (expected_result[i + j] + x) % mod;
+                }
+            }
+            assert(mod_multiply(v1, v2, mod) == expected_result);
+        }
+    }
+
+    /// Concurrent callers, each thread builds its own engines up to a different length
+    vector<vector<long long>> inputs(4), results(4);
+    for (int t = 0; t < 4; t++){
+        inputs[t].resize(1000 << t);
+        for (auto && x: inputs[t]) x = rng() % 1000000;
+        results[t] = mod_multiply(inputs[t], inputs[t], 1000000007);
+    }
+
+    vector<thread> pool;
+    for (int t = 0; t < 4; t++){
+        pool.emplace_back([&, t](){
+            for (int k = 0; k < 4; k++){
+                int i = (t + k) % 4;
+                assert(mod_multiply(inputs[i], inputs[i], 1000000007) == results[i]);
+                assert(mod_multiply(inputs[i], inputs[i], 998244353).size() == results[i].size());
+            }
+        });
+    }
+    for (auto && th: pool) th.join();
+
+    clock_t start = clock();
+
+    v1.resize(1 << 20), v2.resize(1 << 20);
+    for (auto && x: v1) x = rng() % 1000000007;
+    for (auto && x: v2) x = rng() % 1000000007;
+
+    auto res1 = mod_multiply(v1, v2, 998244353);
+    auto res2 = mod_multiply(v1, v2, 1000000007);
+    assert(res1.size() == (1 << 21) - 1 && res2.size() == (1 << 21) - 1);
+
+    fprintf(stderr, "\nTime taken = %0.5f\n", (clock() - start) / (double)CLOCKS_PER_SEC);  /// Time taken = 0.83042
+    return 0;
+}
@@ -0,0 +1,631 @@
+/***
+ * Polynomial toolkit over a prime field
+ *
+ * Every operation works modulo a prime mod below 2^31, on vectors of coefficients from the lowest degree up
+ * Products use a number theoretic transform with Montgomery arithmetic (same engine as ntt.cpp)
+ * NTT-friendly primes like 998244353 take a single transform, any other prime goes through three NTT primes and CRT
+ * The engines are kept per thread, so the methods can be called concurrently from different threads
+ * Short products fall back to the schoolbook method
+ *
+ * Power series (first n coefficients):
+ *   - inverse, log, exp, sqrt and pow with Newton iteration
+ *   - log needs a[0] = 1, exp needs a[0] = 0, sqrt returns an empty vector if there is no square root
+ *
+ * Polynomials:
+ *   - division with remainder
+ *   - multipoint evaluation (transposed, without divisions) and interpolation with subproduct trees
+ *   - Taylor shift, a(x) -> a(x + c)
+ *
+ * Complexity:
+ *   - O(n log n) for multiply, inverse, log, exp, sqrt, pow, divide and taylor_shift
+ *   - O(n log^2 n) for evaluate and interpolate
+ *
+ * Note, n should not exceed mod as log, exp, pow and taylor_shift need the inverses of 1 to n
+ *
+***/
+
+#include <bits/stdc++.h>
+
+using namespace std;
+
+namespace poly{
+    namespace{ /// Anonymous namespace to wrap internally used variables and methods
+        const int NAIVE_LIMIT = 32;
+
+        const uint32_t P1 = 754974721, P2 = 167772161, P3 = 469762049;
+
+        /// Montgomery form with R = 2^32, mod must be odd and less than 2^30
+        struct Montgomery{
+            uint32_t mod, mod2, inv, r2;
+
+            Montgomery(uint32_t mod=1) : mod(mod), mod2(mod * 2){
+                inv = mod;
+                for (int i = 0; i < 5; i++) inv *= 2 - mod * inv;
+                inv = -inv;
+                r2 = (-(uint64_t)mod) % mod;
+            }
+
+            /// x must be less than mod * 2^32, result is in [0, 2 * mod)
+            inline uint32_t reduce(uint64_t x) const{
+                return (x + (uint64_t)((uint32_t)x * inv) * mod) >> 32;
+            }
+
+            inline uint32_t mul(uint32_t a, uint32_t b) const{
+                return reduce((uint64_t)a * b);
+            }
+
+            inline uint32_t add(uint32_t a, uint32_t b) const{
+                a += b;
+                return a >= mod2 ? a - mod2 : a;
+            }
+
+            inline uint32_t sub(uint32_t a, uint32_t b) const{
+                a += mod2 - b;
+                return a >= mod2 ? a - mod2 : a;
+            }
+
+            inline uint32_t normalize(uint32_t x) const{
+                return x >= mod ? x - mod : x;
+            }
+
+            inline uint32_t to_mont(uint32_t x) const{
+                return normalize(mul(x, r2));
+            }
+        };
+
+        uint64_t expo(uint64_t x, uint64_t n, uint64_t mod){
+            uint64_t res = 1;
+            for (x %= mod; n; n >>= 1, x = x * x % mod){
+                if (n & 1) res = res * x % mod;
+            }
+            return res;
+        }
+
+        int get_bit(int len){
+            return 32 - __builtin_clz(len) - (__builtin_popcount(len) == 1);
+        }
+
+        /// Transforms are done in place, forward leaves the result in bit-reversed order and inverse takes it back
+        struct NTT{
+            Montgomery mt;
+            uint32_t mod, root;
+            int max_len;
+            vector<uint32_t> rt, irt;  /// rt[h + j] = w^j where w is the principal (2h)'th root of unity
+
+            NTT(uint32_t mod=0) : mt(mod | 1), mod(mod), root(0), max_len(1), rt(2, 0), irt(2, 0){
+                if (!mod) return;
+                while ((mod - 1) % (2 * max_len) == 0) max_len *= 2;
+
+                vector<uint32_t> factors;
+                uint32_t d, x = mod - 1;
+                for (d = 2; d * d <= x; d++){
+                    if (x % d == 0) factors.push_back(d);
+                    while (x % d == 0) x /= d;
+                }
+                if (x > 1) factors.push_back(x);
+
+                for (root = 2; ; root++){
+                    bool flag = true;
+                    for (auto f: factors) flag = flag && expo(root, (mod - 1) / f, mod) != 1;
+                    if (flag) break;
+                }
+
+                rt[1] = irt[1] = mt.to_mont(1);
+            }
+
+            void build(int len){
+                assert(len <= max_len);
+
+                for (int h = rt.size() >> 1; 2 * h < len; h <<= 1){
+                    rt.resize(4 * h), irt.resize(4 * h);
+                    uint32_t w = mt.to_mont(expo(root, (mod - 1) / (4 * h), mod));
+                    uint32_t iw = mt.to_mont(expo(expo(root, mod - 2, mod), (mod - 1) / (4 * h), mod));
+
+                    for (int j = 0; j < 2 * h; j++){
+                        rt[2 * h + j] = j & 1 ? mt.normalize(mt.mul(rt[h + (j >> 1)], w)) : rt[h + (j >> 1)];
+                        irt[2 * h + j] = j & 1 ? mt.normalize(mt.mul(irt[h + (j >> 1)], iw)) : irt[h + (j >> 1)];
+                    }
+                }
+            }
+
+            void forward(uint32_t* ar, int len){
+                for (int h = len >> 1; h >= 1; h >>= 1){
+                    const uint32_t* w = &rt[h];
+                    for (int i = 0; i < len; i += 2 * h){
+                        uint32_t *a = ar + i, *b = ar + i + h;
+                        for (int j = 0; j < h; j++){
+                            uint32_t x = a[j], y = b[j];
+                            a[j] = mt.add(x, y);
+                            b[j] = mt.mul(x + mt.mod2 - y, w[j]);
+                        }
+                    }
+                }
+            }
+
+            void inverse(uint32_t* ar, int len){
+                for (int h = 1; h < len; h <<= 1){
+                    const uint32_t* w = &irt[h];
+                    for (int i = 0; i < len; i += 2 * h){
+                        uint32_t *a = ar + i, *b = ar + i + h;
+                        for (int j = 0; j < h; j++){
+                            uint32_t x = a[j], y = mt.mul(b[j], w[j]);
+                            a[j] = mt.add(x, y);
+                            b[j] = mt.sub(x, y);
+                        }
+                    }
+                }
+            }
+
+            /// Returns the product of v1 and v2 modulo this prime, truncated to p_len values
+            vector<uint32_t> multiply(const vector<long long>& v1, const vector<long long>& v2, int p_len, bool is_equal){
+                int i, len = 1 << get_bit(p_len);
+                build(len);
+
+                vector<uint32_t> f(len, 0), g;
+                for (i = 0; i < (int)v1.size(); i++) f[i] = (v1[i] % mod + mod) % mod;
+                forward(f.data(), len);
+
+                if (is_equal) g = f;
+                else{
+                    g.assign(len, 0);
+                    for (i = 0; i < (int)v2.size(); i++) g[i] = (v2[i] % mod + mod) % mod;
+                    forward(g.data(), len);
+                }
+
+                /// The pointwise product introduces a factor of 1/R, which is cancelled along with 1/len at the end
+                for (i = 0; i < len; i++) f[i] = mt.mul(f[i], g[i]);
+                inverse(f.data(), len);
+
+                uint32_t scale = mt.to_mont(mt.to_mont(expo(len, mod - 2, mod)));
+                f.resize(p_len);
+                for (i = 0; i < p_len; i++) f[i] = mt.normalize(mt.mul(f[i], scale));
+                return f;
+            }
+        };
+
+        /// One set of engines per thread, as they cache roots and are extended on demand
+        thread_local map<uint32_t, NTT> engines;
+
+        NTT& get_engine(uint32_t mod){
+            auto it = engines.find(mod);
+            if (it == engines.end()) it = engines.emplace(mod, NTT(mod)).first;
+            return it->second;
+        }
+
+        bool is_ntt_prime(int mod, int p_len){
+            return mod < (1 << 30) && (mod - 1) % (1 << get_bit(p_len)) == 0;
+        }
+
+        /// Garner's algorithm, the value of x modulo P1 * P2 * P3 is r1 + x2 * P1 + x3 * P1 * P2
+        inline void garner(uint32_t r1, uint32_t r2, uint32_t r3, uint64_t& x2, uint64_t& x3){
+            static const uint64_t inv_1_2 = expo(P1, P2 - 2, P2), inv_1_3 = expo(P1, P3 - 2, P3);
+            static const uint64_t inv_2_3 = expo(P2, P3 - 2, P3);
+
+            x2 = (r2 + P2 - r1 % P2) * inv_1_2 % P2;
+            x3 = ((r3 + P3 - r1 % P3) * inv_1_3 % P3 + P3 - x2 % P3) * inv_2_3 % P3;
+        }
+
+        long long inverse_mod(long long x, int mod){
+            assert(x % mod != 0);
+            return expo((x % mod + mod) % mod, mod - 2, mod);
+        }
+
+        /// inv[i] = 1 / i for i in [1, n]
+        vector<long long> inverse_table(int n, int mod){
+            vector<long long> inv(n + 1, 1);
+            for (int i = 2; i <= n; i++) inv[i] = (mod - (mod / i) * inv[mod % i] % mod) % mod;
+            return inv;
+        }
+
+        /// Square root of x modulo the prime mod with Tonelli-Shanks, -1 if x is not a quadratic residue
+        long long sqrt_mod(long long x, int mod){
+            x %= mod;
+            if (x == 0 || mod == 2) return x;
+            if (expo(x, (mod - 1) / 2, mod) != 1) return -1;
+
+            long long q = mod - 1, s = 0, z = 2;
+            while (!(q & 1)) q >>= 1, s++;
+            while (expo(z, (mod - 1) / 2, mod) == 1) z++;
+
+            long long m = s, c = expo(z, q, mod), t = expo(x, q, mod), r = expo(x, (q + 1) / 2, mod);
+            while (t != 1){
+                long long i = 0, y = t;
+                while (y != 1) y = y * y % mod, i++;
+
+                long long b = c;
+                for (long long j = 0; j < m - i - 1; j++) b = b * b % mod;
+                m = i, c = b * b % mod, t = t * c % mod, r = r * b % mod;
+            }
+            return min(r, mod - r);
+        }
+
+        vector<long long> naive_multiply(const vector<long long>& a, const vector<long long>& b, int mod){
+            vector<unsigned long long> res(a.size() + b.size() - 1, 0);
+            for (int i = 0; i < (int)a.size(); i++){
+                for (int j = 0; j < (int)b.size(); j++){
+                    res[i + j] += (unsigned long long)a[i] * b[j];
+                    if (res[i + j] >> 63) res[i + j] %= mod;
+                }
+            }
+            return vector<long long>(res.begin(), res.end());
+        }
+
+        /// a with at most n coefficients, padded with zeros up to n
+        vector<long long> truncate(const vector<long long>& a, int n){
+            vector<long long> res(a.begin(), a.begin() + min(n, (int)a.size()));
+            res.resize(n, 0);
+            return res;
+        }
+
+        /// Index of the first non zero coefficient, a.size() if there is none
+        int lowest_term(const vector<long long>& a){
+            int i = 0;
+            while (i < (int)a.size() && a[i] == 0) i++;
+            return i;
+        }
+    }
+
+    /***
+     * Product of a and b modulo mod, values must be in [0, mod)
+     *
+    ***/
+    vector<long long> multiply(const vector<long long>& a, const vector<long long>& b, int mod){
+        if (a.empty() || b.empty()) return {};
+
+        int i, p_len = a.size() + b.size() - 1;
+        if (min(a.size(), b.size()) <= NAIVE_LIMIT){
+            auto res = naive_multiply(a, b, mod);
+            for (auto&& x: res) x %= mod;
+            return res;
+        }
+
+        bool is_equal = (a == b);
+        vector<long long> res(p_len, 0);
+        if (is_ntt_prime(mod, p_len)){
+            auto f = get_engine(mod).multiply(a, b, p_len, is_equal);
+            for (i = 0; i < p_len; i++) res[i] = f[i];
+            return res;
+        }
+
+        auto f1 = get_engine(P1).multiply(a, b, p_len, is_equal);
+        auto f2 = get_engine(P2).multiply(a, b, p_len, is_equal);
+        auto f3 = get_engine(P3).multiply(a, b, p_len, is_equal);
+
+        uint64_t x2, x3, p1 = P1 % mod, p12 = (uint64_t)P1 * P2 % mod;
+        for (i = 0; i < p_len; i++){
+            garner(f1[i], f2[i], f3[i], x2, x3);
+            res[i] = (f1[i] + x2 * p1 % mod + x3 * p12 % mod) % mod;
+        }
+        return res;
+    }
+
+    /***
+     * First n coefficients of 1 / a, a[0] must not be zero
+     *
+    ***/
+    vector<long long> inverse(const vector<long long>& a, int n, int mod){
+        assert(!a.empty() && a[0] != 0);
+
+        vector<long long> res = {inverse_mod(a[0], mod)};
+        for (int m = 1; m < n; ){
+            m = min(2 * m, n);
+
+            /// b <- b * (2 - a * b) mod x^m
+            auto c = truncate(multiply(truncate(a, m), res, mod), m);
+            for (auto&& x: c) x = x ? mod - x : 0;
+            c[0] = (c[0] + 2) % mod;
+            res = truncate(multiply(res, c, mod), m);
+        }
+        return truncate(res, n);
+    }
+
+    vector<long long> derivative(const vector<long long>& a, int mod){
+        if (a.size() <= 1) return {};
+
+        vector<long long> res(a.size() - 1);
+        for (int i = 1; i < (int)a.size(); i++) res[i - 1] = a[i] * i % mod;
+        return res;
+    }
+
+    vector<long long> integral(const vector<long long>& a, int mod){
+        auto inv = inverse_table(a.size(), mod);
+        vector<long long> res(a.size() + 1, 0);
+        for (int i = 0; i < (int)a.size(); i++) res[i + 1] = a[i] * inv[i + 1] % mod;
+        return res;
+    }
+
+    /***
+     * First n coefficients of log(a), a[0] must be 1
+     *
+    ***/
+    vector<long long> log(const vector<long long>& a, int n, int mod){
+        assert(!a.empty() && a[0] == 1);
+        if (n <= 1) return vector<long long>(n, 0);
+
+        auto res = multiply(derivative(truncate(a, n), mod), inverse(a, n - 1, mod), mod);
+        return truncate(integral(truncate(res, n - 1), mod), n);
+    }
+
+    /***
+     * First n coefficients of exp(a), a[0] must be 0
+     *
+    ***/
+    vector<long long> exp(const vector<long long>& a, int n, int mod){
+        assert(a.empty() || a[0] == 0);
+
+        vector<long long> res = {1 % mod};
+        for (int m = 1; m < n; ){
+            m = min(2 * m, n);
+
+            /// b <- b * (1 - log(b) + a) mod x^m
+            auto c = log(res, m, mod), b = truncate(a, m);
+            for (int i = 0; i < m; i++) c[i] = (b[i] - c[i] + mod) % mod;
+            c[0] = (c[0] + 1) % mod;
+            res = truncate(multiply(res, c, mod), m);
+        }
+        return truncate(res, n);
+    }
+
+    /***
+     * First n coefficients of a square root of a, or an empty vector if there is none
+     * The lowest non zero term must have an even degree and a quadratic residue as coefficient
+     *
+    ***/
+    vector<long long> sqrt(const vector<long long>& a, int n, int mod){
+        int t = lowest_term(a);
+        if (t == (int)a.size() || t / 2 >= n) return vector<long long>(n, 0);
+
+        long long r = sqrt_mod(a[t], mod);
+        if ((t & 1) || r == -1) return {};
+
+        const long long half = (mod + 1) / 2;
+        vector<long long> b(a.begin() + t, a.end()), res = {r};
+
+        for (int m = 1; m < n - t / 2; ){
+            m = min(2 * m, n - t / 2);
+
+            /// s <- (s + b / s) / 2 mod x^m
+            auto c = truncate(multiply(truncate(b, m), inverse(res, m, mod), mod), m);
+            res.resize(m, 0);
+            for (int i = 0; i < m; i++) res[i] = (res[i] + c[i]) * half % mod;
+        }
+
+        res.insert(res.begin(), t / 2, 0);
+        return truncate(res, n);
+    }
+
+    /***
+     * First n coefficients of a^k
+     *
+    ***/
+    vector<long long> pow(const vector<long long>& a, long long k, int n, int mod){
+        vector<long long> res(n, 0);
+        if (k == 0){
+            if (n) res[0] = 1 % mod;
+            return res;
+        }
+
+        int t = lowest_term(a);
+        if (t == (int)a.size() || (t && k >= (n + t - 1) / t)) return res;
+
+        /// a^k = (c x^t)^k * exp(k * log(a / (c x^t)))
+        long long c = a[t], ck = expo(c, k % (mod - 1), mod), ic = inverse_mod(c, mod);
+        int m = n - t * k;
+
+        vector<long long> b(a.begin() + t, a.end());
+        for (auto&& x: b) x = x * ic % mod;
+
+        auto l = log(b, m, mod);
+        for (auto&& x: l) x = x * (k % mod) % mod;
+        auto e = exp(l, m, mod);
+
+        for (int i = 0; i < m; i++) res[i + t * k] = e[i] * ck % mod;
+        return res;
+    }
+
+    /***
+     * Quotient and remainder of a divided by b, the leading coefficient of b must not be zero
+     * The quotient has a.size() - b.size() + 1 coefficients and the remainder b.size() - 1
+     *
+    ***/
+    pair<vector<long long>, vector<long long>> divide(const vector<long long>& a, const vector<long long>& b, int mod){
+        int n = a.size(), m = b.size();
+        assert(m > 0 && b.back() != 0);
+        if (n < m) return {{}, truncate(a, m - 1)};
+
+        int k = n - m + 1;
+        vector<long long> ra(a.rbegin(), a.rend()), rb(b.rbegin(), b.rend());
+
+        auto q = truncate(multiply(truncate(ra, k), inverse(rb, k, mod), mod), k);
+        reverse(q.begin(), q.end());
+
+        auto r = truncate(multiply(q, truncate(b, m - 1), mod), m - 1);
+        for (int i = 0; i < m - 1; i++) r[i] = (a[i] - r[i] + mod) % mod;
+        return {q, r};
+    }
+
+    vector<long long> remainder(const vector<long long>& a, const vector<long long>& b, int mod){
+        return divide(a, b, mod).second;
+    }
+
+    namespace{
+        /// tree[node] = product of (1 - xs[i] * x) for i in [l, r), the reversed subproduct tree
+        void build_tree(vector<vector<long long>>& tree, const vector<long long>& xs, int node, int l, int r, int mod){
+            if (r - l == 1){
+                tree[node] = {1, (mod - xs[l] % mod) % mod};
+                return;
+            }
+
+            int mid = (l + r) / 2;
+            build_tree(tree, xs, 2 * node, l, mid, mod);
+            build_tree(tree, xs, 2 * node + 1, mid, r, mod);
+            tree[node] = multiply(tree[2 * node], tree[2 * node + 1], mod);
+        }
+
+        /// Transposed product, res[i] = sum of a[i + j] * b[j] for i in [0, k)
+        vector<long long> middle_product(const vector<long long>& a, const vector<long long>& b, int k, int mod){
+            int m = b.size();
+            auto c = multiply(a, vector<long long>(b.rbegin(), b.rend()), mod);
+
+            vector<long long> res(k, 0);
+            for (int i = 0; i < k && i + m - 1 < (int)c.size(); i++) res[i] = c[i + m - 1];
+            return res;
+        }
+
+        /***
+         * Transposed multipoint evaluation (Tellegen's principle), where t[i] = sum of a[i + j] * [x^j] (1 / tree[node])
+         * Going down only needs middle products with the sibling, no divisions, and t[0] = a(xs[l]) at the leaves
+         *
+        ***/
+        void evaluate_tree(const vector<vector<long long>>& tree, const vector<long long>& t, int node, int l, int r, vector<long long>& res, int mod){
+            if (r - l == 1){
+                res[l] = t[0];
+                return;
+            }
+
+            int mid = (l + r) / 2;
+            evaluate_tree(tree, middle_product(t, tree[2 * node + 1], mid - l, mod), 2 * node, l, mid, res, mod);
+            evaluate_tree(tree, middle_product(t, tree[2 * node], r - mid, mod), 2 * node + 1, mid, r, res, mod);
+        }
+
+        /// Values of a at the points of the tree
+        vector<long long> evaluate_tree(const vector<vector<long long>>& tree, const vector<long long>& a, int n, int mod){
+            vector<long long> res(n, 0);
+            if (a.empty()) return res;
+
+            auto t = middle_product(a, inverse(tree[1], a.size(), mod), n, mod);
+            evaluate_tree(tree, t, 1, 0, n, res, mod);
+            return res;
+        }
+
+        /// Sum of w[i] * tree[node] / (1 - xs[i] * x) for i in [l, r)
+        vector<long long> combine_tree(const vector<vector<long long>>& tree, const vector<long long>& w, int node, int l, int r, int mod){
+            if (r - l == 1) return {w[l]};
+
+            int mid = (l + r) / 2;
+            auto a = multiply(combine_tree(tree, w, 2 * node, l, mid, mod), tree[2 * node + 1], mod);
+            auto b = multiply(combine_tree(tree, w, 2 * node + 1, mid, r, mod), tree[2 * node], mod);
+
+            a.resize(max(a.size(), b.size()), 0);
+            for (int i = 0; i < (int)b.size(); i++) a[i] = (a[i] + b[i]) % mod;
+            return a;
+        }
+    }
+
+    /***
+     * Values of a at every point of xs
+     *
+    ***/
+    vector<long long> evaluate(const vector<long long>& a, const vector<long long>& xs, int mod){
+        int n = xs.size();
+        if (n == 0) return {};
+
+        vector<vector<long long>> tree(4 * n);
+        build_tree(tree, xs, 1, 0, n, mod);
+        return evaluate_tree(tree, a, n, mod);
+    }
+
+    /***
+     * The unique polynomial of degree less than n with value ys[i] at xs[i], the points in xs must be distinct
+     *
+    ***/
+    vector<long long> interpolate(const vector<long long>& xs, const vector<long long>& ys, int mod){
+        int n = xs.size();
+        assert(n == (int)ys.size());
+        if (n == 0) return {};
+
+        vector<vector<long long>> tree(4 * n);
+        build_tree(tree, xs, 1, 0, n, mod);
+
+        /// The weight of every point is ys[i] / M'(xs[i]), where M is the product of all (x - xs[i]), the reverse of tree[1]
+        auto w = evaluate_tree(tree, derivative(vector<long long>(tree[1].rbegin(), tree[1].rend()), mod), n, mod);
+        for (int i = 0; i < n; i++) w[i] = (ys[i] % mod + mod) % mod * inverse_mod(w[i], mod) % mod;
+
+        /// The sum of w[i] * M / (x - xs[i]) is the reverse of the same sum over the reversed tree
+        auto res = truncate(combine_tree(tree, w, 1, 0, n, mod), n);
+        reverse(res.begin(), res.end());
+        return res;
+    }
+
+    /***
+     * Coefficients of a(x + c)
+     *
+    ***/
+    vector<long long> taylor_shift(const vector<long long>& a, long long c, int mod){
+        int i, n = a.size();
+        if (n == 0) return {};
+
+        vector<long long> fact(n, 1), ifact(n, 1), f(n), g(n);
+        for (i = 1; i < n; i++) fact[i] = fact[i - 1] * i % mod;
+        ifact[n - 1] = inverse_mod(fact[n - 1], mod);
+        for (i = n - 1; i > 0; i--) ifact[i - 1] = ifact[i] * i % mod;
+
+        /// res[k] = (1 / k!) * sum of (a[i] * i!) * (c^(i - k) / (i - k)!)
+        c = (c % mod + mod) % mod;
+        long long p = 1;
+        for (i = 0; i < n; i++){
+            f[n - 1 - i] = a[i] * fact[i] % mod;
+            g[i] = p * ifact[i] % mod, p = p * c % mod;
+        }
+
+        auto h = multiply(f, g, mod);
+        vector<long long> res(n);
+        for (i = 0; i < n; i++) res[i] = h[n - 1 - i] * ifact[i] % mod;
+        return res;
+    }
+}
+
+int main(){
+    using namespace poly;
+
+    const int mod = 998244353;
+    vector<long long> a, b, res;
+
+    /// 1 / (1 - x) = 1 + x + x^2 + ...
+    assert(inverse({1, mod - 1}, 5, mod) == vector<long long>({1, 1, 1, 1, 1}));
+
+    /// log(1 / (1 - x)) = x + x^2 / 2 + x^3 / 3 + ...
+    a = log(inverse({1, mod - 1}, 4, mod), 4, mod);
+    assert(a[0] == 0 && a[1] == 1 && a[2] * 2 % mod == 1 && a[3] * 3 % mod == 1);
+    assert(exp(a, 4, mod) == vector<long long>({1, 1, 1, 1}));
+
+    /// (1 + x)^2 = 1 + 2x + x^2, also with a leading zero term
+    assert(sqrt({1, 2, 1}, 3, mod) == vector<long long>({1, 1, 0}));
+    assert(sqrt({0, 0, 4, 4, 1}, 4, mod) == vector<long long>({0, 2, 1, 0}));
+    assert(sqrt({0, 1}, 3, mod).empty());
+
+    assert(pow({0, 1, 1}, 3, 6, mod) == vector<long long>({0, 0, 0, 1, 3, 3}));
+
+    auto [q, r] = divide({1, 2, 3, 4}, {1, 1}, mod);  /// 4x^3 + 3x^2 + 2x + 1 = (x + 1)(4x^2 - x + 3) - 2
+    assert(q == vector<long long>({3, mod - 1, 4}) && r == vector<long long>({mod - 2}));
+
+    assert(evaluate({1, 2, 3}, {0, 1, 2, 3}, mod) == vector<long long>({1, 6, 17, 34}));
+    assert(interpolate({0, 1, 2, 3}, {1, 6, 17, 34}, mod) == vector<long long>({1, 2, 3, 0}));
+    assert(taylor_shift({0, 0, 1}, 1, mod) == vector<long long>({1, 2, 1}));
+
+    /// Any prime works, others go through three NTT primes
+    const int mod2 = 1000000007;
+    mt19937 rng(0);
+    a.resize(1000), b.resize(1000);
+    for (auto&& x: a) x = rng() % mod2;
+    a[0] = 0;
+    b = log(exp(a, 1000, mod2), 1000, mod2);
+    assert(a == b);
+
+    clock_t start = clock();
+
+    int n = 100000;
+    a.resize(n), b.resize(n);
+    for (auto&& x: a) x = rng() % mod;
+    for (int i = 0; i < n; i++) b[i] = i;  /// interpolation needs distinct points
+    a[0] = 0;
+
+    res = exp(a, n, mod);
+    assert(log(res, n, mod) == a);
+
+    res = evaluate(a, b, mod);
+    assert(interpolate(b, res, mod) == a);
+
+    fprintf(stderr, "\nTime taken = %0.5f\n", (clock() - start) / (double)CLOCKS_PER_SEC);  /// Time taken = 2.20121
+    return 0;
+}
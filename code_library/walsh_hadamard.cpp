@@ -1,24 +1,42 @@
 /***
- * 
+ *
  * Fast Walsh Hadamard Transformation to calculate convolution between two vectors
  * Convolution type can be either xor/or/and
  * Complexity for all convolutions: O(n log n)
- * 
+ *
  * Convolutions of two vectors A, B of length N can be defined as below:
  * C = [0] * n
  * for i in range(0, n):
  *     for j in range(0, n):
  *          C[i operator j] += A[i] * B[j] // where operator is one of {^, |, &}
  *
+ * The transforms are iterative, the convolution type is a template parameter so the inner loops never branch on it
+ * The first levels are done block by block inside the cache, the rest up to three levels per pass over the memory
+ * Butterflies are vectorized with AVX2 whenever the CPU supports it, detected at runtime
+ *
+ * Two kinds of values are supported
+ *     i) long long, exact as long as nothing overflows (arithmetic wraps around modulo 2^64 otherwise)
+ *    ii) int modulo mod, where mod is below 2^31 and odd for XOR so that the inverse of n exists
+ *
+ * transform<OR> is the zeta transform over subsets (the sum over all subsets of every mask) and inverse_transform<OR>
+ * is its Mobius transform, AND gives the same over supersets
+ * subset_convolution() sums A[i] * B[j] only over disjoint i and j, in O(n log^2 n) with ranked zeta transforms
+ *
+ * Large transforms can be split among several threads with set_threads(), which is off by default
+ * Compile with -pthread in that case on older toolchains
+ *
  * Notes:
  *   - A and B must be of the same length n
  *   - n must be a power of 2
- * 
+ *
 ***/
 
 #include <bits/stdc++.h>
 
-#define MAX 1048576
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define FWHT_X86_KERNELS
+#endif
 
 using namespace std;
 
@@ -27,51 +45,311 @@ namespace fwht{
     const int AND = 1;
     const int XOR = 2;
 
-    long long P1[MAX], P2[MAX];
+    namespace{ /// Anonymous namespace to wrap internally used variables and methods
+        const int BLOCK_SIZE = 16384, CHUNK_SIZE = 256, MAX_LEVELS = 3, PARALLEL_GRAIN = 1 << 16;
 
-    void walsh_transform(long long* ar, int n, int conv_type){
-        if (!n) return;
-
-        int m = n >> 1;
-        walsh_transform(ar, m, conv_type);
-        walsh_transform(ar + m, m, conv_type);
-
-        /// Add modulo operations below if required
-        for (int i = 0; i < m; i++){
-            long long x = ar[i], y = ar[i + m];
-            if (conv_type == OR) ar[i] = x, ar[i + m] = x + y;
-            if (conv_type == AND) ar[i] = x + y, ar[i + m] = y;
-            if (conv_type == XOR) ar[i] = x + y, ar[i + m] = x - y;
+        int num_threads = 1;
+
+#ifdef FWHT_X86_KERNELS
+        bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+        /***
+         * Runs func(lo, hi) over disjoint ranges covering [0, n), one range per thread
+         * Stays on the calling thread if there is not at least grain work for every thread
+         *
+        ***/
+        template <typename F>
+        void parallel_for(int n, F func, int grain=PARALLEL_GRAIN){
+            int t, threads = min(num_threads, n / max(grain, 1));
+            if (threads <= 1) return func(0, n);
+
+            vector<thread> pool;
+            for (t = 1; t < threads; t++){
+                pool.emplace_back(func, (int)((long long)n * t / threads), (int)((long long)n * (t + 1) / threads));
+            }
+            func(0, n / threads);
+            for (auto&& th: pool) th.join();
+        }
+
+        /// Plain 64 bit integers, unsigned so that overflow wraps around instead of being undefined
+        struct Integer{
+            static inline uint64_t add(uint64_t a, uint64_t b){
+                return a + b;
+            }
+
+            static inline uint64_t sub(uint64_t a, uint64_t b){
+                return a - b;
+            }
+
+#ifdef FWHT_X86_KERNELS
+            __attribute__((target("avx2")))
+            static inline __m256i add(__m256i a, __m256i b){
+                return _mm256_add_epi64(a, b);
+            }
+
+            __attribute__((target("avx2")))
+            static inline __m256i sub(__m256i a, __m256i b){
+                return _mm256_sub_epi64(a, b);
+            }
+#endif
+        };
+
+        /// Values in [0, mod) with mod below 2^31, so that the sum of two values never overflows
+        struct Modular{
+            uint32_t mod;
+
+            inline uint32_t add(uint32_t a, uint32_t b) const{
+                a += b;
+                return a >= mod ? a - mod : a;
+            }
+
+            inline uint32_t sub(uint32_t a, uint32_t b) const{
+                a += mod - b;
+                return a >= mod ? a - mod : a;
+            }
+
+#ifdef FWHT_X86_KERNELS
+            __attribute__((target("avx2")))
+            inline __m256i add(__m256i a, __m256i b) const{
+                __m256i x = _mm256_add_epi32(a, b);
+                return _mm256_min_epu32(x, _mm256_sub_epi32(x, _mm256_set1_epi32(mod)));
+            }
+
+            __attribute__((target("avx2")))
+            inline __m256i sub(__m256i a, __m256i b) const{
+                __m256i x = _mm256_add_epi32(_mm256_sub_epi32(a, b), _mm256_set1_epi32(mod));
+                return _mm256_min_epu32(x, _mm256_sub_epi32(x, _mm256_set1_epi32(mod)));
+            }
+#endif
+        };
+
+        /// count butterflies between a and b, the inverse ones leave the 1/2 factors of XOR out
+        template <int CONV, bool INVERSE, typename Arith, typename T>
+        void butterfly_scalar(const Arith& op, T* a, T* b, int count){
+            for (int j = 0; j < count; j++){
+                T x = a[j], y = b[j];
+                if (CONV == XOR) a[j] = op.add(x, y), b[j] = op.sub(x, y);
+                if (CONV == OR) b[j] = INVERSE ? op.sub(y, x) : op.add(x, y);
+                if (CONV == AND) a[j] = INVERSE ? op.sub(x, y) : op.add(x, y);
+            }
+        }
+
+#ifdef FWHT_X86_KERNELS
+        template <int CONV, bool INVERSE, typename Arith, typename T>
+        __attribute__((target("avx2")))
+        void butterfly_avx2(const Arith& op, T* a, T* b, int count){
+            const int step = 32 / sizeof(T);
+
+            int j;
+            for (j = 0; j + step <= count; j += step){
+                __m256i x = _mm256_loadu_si256((__m256i*)(a + j)), y = _mm256_loadu_si256((__m256i*)(b + j));
+                if (CONV == XOR){
+                    _mm256_storeu_si256((__m256i*)(a + j), op.add(x, y));
+                    _mm256_storeu_si256((__m256i*)(b + j), op.sub(x, y));
+                }
+                if (CONV == OR) _mm256_storeu_si256((__m256i*)(b + j), INVERSE ? op.sub(y, x) : op.add(x, y));
+                if (CONV == AND) _mm256_storeu_si256((__m256i*)(a + j), INVERSE ? op.sub(x, y) : op.add(x, y));
+            }
+            butterfly_scalar<CONV, INVERSE>(op, a + j, b + j, count - j);
+        }
+#endif
+
+        template <int CONV, bool INVERSE, typename Arith, typename T>
+        inline void butterfly(const Arith& op, T* a, T* b, int count){
+#ifdef FWHT_X86_KERNELS
+            if (has_avx2 && count >= 8) return butterfly_avx2<CONV, INVERSE>(op, a, b, count);
+#endif
+            butterfly_scalar<CONV, INVERSE>(op, a, b, count);
         }
+
+        /***
+         * In-place transform without any normalization, the levels can be done in any order since they commute
+         *
+         * Levels with blocks up to BLOCK_SIZE are finished one block at a time, each thread taking a contiguous set of blocks
+         * The levels above that are done up to MAX_LEVELS at a time, so that each pass over the memory does several of them
+         *
+        ***/
+        template <int CONV, bool INVERSE, typename Arith, typename T>
+        void run(const Arith& op, T* ar, int n){
+            int h, levels, block = min(n, BLOCK_SIZE);
+
+            parallel_for(n / block, [&](int lo, int hi){
+                for (int k = lo; k < hi; k++){
+                    T* p = ar + (long long)k * block;
+                    for (int s = 1; s < block; s <<= 1){
+                        for (int i = 0; i < block; i += 2 * s) butterfly<CONV, INVERSE>(op, p + i, p + i + s, s);
+                    }
+                }
+            }, max(1, PARALLEL_GRAIN / block));
+
+            for (h = block; h < n; h <<= levels){
+                levels = min(MAX_LEVELS, __builtin_ctz(n / h));
+
+                /***
+                 * The p'th group starts at (p / h) * (h << levels) + (p % h) and has 2^levels streams h positions apart
+                 * Each chunk of the streams goes through all the levels while it is still in the cache
+                 *
+                ***/
+                parallel_for(n >> levels, [&](int lo, int hi){
+                    T* streams[1 << MAX_LEVELS];
+                    for (int p = lo, j, count; p < hi; p += count){
+                        j = p & (h - 1), count = min({h - j, hi - p, CHUNK_SIZE});
+
+                        streams[0] = ar + ((long long)(p - j) << levels) + j;
+                        for (int t = 1; t < (1 << levels); t++) streams[t] = streams[t - 1] + h;
+
+                        for (int l = 0; l < levels; l++){
+                            for (int t = 0; t < (1 << levels); t++){
+                                if (!(t >> l & 1)) butterfly<CONV, INVERSE>(op, streams[t], streams[t | (1 << l)], count);
+                            }
+                        }
+                    }
+                });
+            }
+        }
+
+        template <bool INVERSE, typename Arith, typename T>
+        void run(const Arith& op, T* ar, int n, int conv_type){
+            if (conv_type == OR) run<OR, INVERSE>(op, ar, n);
+            if (conv_type == AND) run<AND, INVERSE>(op, ar, n);
+            if (conv_type == XOR) run<XOR, INVERSE>(op, ar, n);
+        }
+
+        inline uint32_t mod_mul(uint32_t a, uint32_t b, uint32_t mod){
+            return (uint64_t)a * b % mod;
+        }
+
+        uint32_t mod_inverse(uint32_t a, uint32_t mod){
+            long long x = 1, y = 0, p = a, q = mod;
+            while (q){
+                long long t = p / q;
+                swap(p -= t * q, q), swap(x -= t * y, y);
+            }
+            assert(p == 1);
+            return (x % mod + mod) % mod;
+        }
+
+        /// XOR needs the 1/n factor, the other inverse transforms are exact as they are
+        void normalize(long long* ar, int n, int conv_type){
+            if (conv_type != XOR) return;
+
+            int s = __builtin_ctz(n);
+            parallel_for(n, [&](int lo, int hi){
+                for (int i = lo; i < hi; i++) ar[i] >>= s;
+            });
+        }
+
+        void normalize(int* ar, int n, int conv_type, int mod){
+            if (conv_type != XOR) return;
+
+            uint32_t inv = mod_inverse(n % mod, mod);
+            parallel_for(n, [&](int lo, int hi){
+                for (int i = lo; i < hi; i++) ar[i] = mod_mul(ar[i], inv, mod);
+            });
+        }
+
+        /// f[r * n + i] = A[i] if i has r bits set, 0 otherwise, followed by the zeta transform of every rank
+        template <typename Arith, typename T>
+        vector<T> ranked_zeta(const Arith& op, const vector<T>& A, int k){
+            int n = A.size();
+            vector<T> f((long long)(k + 1) * n, 0);
+            for (int i = 0; i < n; i++) f[(long long)__builtin_popcount(i) * n + i] = A[i];
+            for (int r = 0; r <= k; r++) run<OR, false>(op, f.data() + (long long)r * n, n);
+            return f;
+        }
+
+        /// Value of the inverse ranked transform at every mask, taken from the rank equal to its number of bits
+        template <typename Arith, typename T>
+        vector<T> unrank(const Arith& op, vector<T>& f, int n, int k){
+            vector<T> res(n);
+            for (int r = 0; r <= k; r++) run<OR, true>(op, f.data() + (long long)r * n, n);
+            for (int i = 0; i < n; i++) res[i] = f[(long long)__builtin_popcount(i) * n + i];
+            return res;
+        }
+    }
+
+    /***
+     * Sets the number of threads used by the methods below, 1 by default
+     * Pass 0 to use all the hardware threads available
+     *
+     * Only large inputs are split among threads, small ones always run on the calling thread
+     *
+    ***/
+    void set_threads(int threads){
+        num_threads = threads > 0 ? threads : max(1, (int)thread::hardware_concurrency());
+    }
+
+    /***
+     * In-place transforms of n values, CONV is one of OR, AND and XOR
+     * The inverse XOR transform divides by n exactly, which is only correct for transforms of actual integer vectors
+     *
+    ***/
+    template <int CONV>
+    void transform(long long* ar, int n){
+        run<CONV, false>(Integer(), (uint64_t*)ar, n);
+    }
+
+    template <int CONV>
+    void inverse_transform(long long* ar, int n){
+        run<CONV, true>(Integer(), (uint64_t*)ar, n);
+        normalize(ar, n, CONV);
+    }
+
+    /***
+     * Same as above, modulo mod with values in [0, mod)
+     * mod must be below 2^31, and the inverse XOR transform needs it to be odd
+     *
+    ***/
+    template <int CONV>
+    void transform(int* ar, int n, int mod){
+        run<CONV, false>(Modular{(uint32_t)mod}, (uint32_t*)ar, n);
+    }
+
+    template <int CONV>
+    void inverse_transform(int* ar, int n, int mod){
+        run<CONV, true>(Modular{(uint32_t)mod}, (uint32_t*)ar, n);
+        normalize(ar, n, CONV, mod);
+    }
+
+    void walsh_transform(long long* ar, int n, int conv_type){
+        run<false>(Integer(), (uint64_t*)ar, n, conv_type);
     }
 
     void inverse_walsh_transform(long long* ar, int n, int conv_type){
-        if (!n) return;
-
-        int m = n >> 1;
-        inverse_walsh_transform(ar, m, conv_type);
-        inverse_walsh_transform(ar + m, m, conv_type);
-
-        /// Add modulo operations below if required, inverse modulo may be requried for XOR
-        for (int i = 0; i < m; i++){
-            long long x = ar[i], y = ar[i + m];
-            if (conv_type == OR) ar[i] = x, ar[i + m] = y - x;
-            if (conv_type == AND) ar[i] = x - y, ar[i + m] = y;
-            if (conv_type == XOR) ar[i] = (x + y) >> 1, ar[i + m] = (x - y) >> 1;
-        }
+        run<true>(Integer(), (uint64_t*)ar, n, conv_type);
+        normalize(ar, n, conv_type);
+    }
+
+    /// ar[mask] becomes the sum of ar[sub] over all subsets sub of mask, and back
+    void subset_zeta(long long* ar, int n){
+        transform<OR>(ar, n);
+    }
+
+    void subset_mobius(long long* ar, int n){
+        inverse_transform<OR>(ar, n);
+    }
+
+    void subset_zeta(int* ar, int n, int mod){
+        transform<OR>(ar, n, mod);
+    }
+
+    void subset_mobius(int* ar, int n, int mod){
+        inverse_transform<OR>(ar, n, mod);
     }
 
     vector <long long> convolution(const vector <long long>& A, const vector <long long>& B, int conv_type){
         int n = A.size();
         assert(A.size() == B.size() && __builtin_popcount(n) == 1);
-        for (int i = 0; i < n; i++) P1[i] = A[i];
-        for (int i = 0; i < n; i++) P2[i] = B[i];
 
-        walsh_transform(P1, n, conv_type);
-        walsh_transform(P2, n, conv_type);
-        for (int i = 0; i < n; i++) P1[i] = P1[i] * P2[i];
-        inverse_walsh_transform(P1, n, conv_type);
-        return vector<long long> (P1, P1 + n);
+        vector <long long> P1 = A, P2 = B;
+        walsh_transform(P1.data(), n, conv_type);
+        walsh_transform(P2.data(), n, conv_type);
+        parallel_for(n, [&](int lo, int hi){
+            for (int i = lo; i < hi; i++) P1[i] = (uint64_t)P1[i] * P2[i];
+        });
+        inverse_walsh_transform(P1.data(), n, conv_type);
+        return P1;
     }
 
     vector <long long> or_convolution(const vector <long long>& A, const vector <long long>& B){
@@ -85,15 +363,213 @@ namespace fwht{
     vector <long long> xor_convolution(const vector <long long>& A, const vector <long long>& B){
         return convolution(A, B, XOR);
     }
+
+    /***
+     * Same as convolution(A, B, conv_type), only values are calculated modulo mod
+     * mod must be below 2^31 and odd for XOR, values can be negative
+     *
+    ***/
+    vector <int> mod_convolution(const vector <int>& A, const vector <int>& B, int conv_type, int mod){
+        int n = A.size();
+        assert(A.size() == B.size() && __builtin_popcount(n) == 1 && mod > 0);
+
+        vector <int> P1(n), P2(n);
+        for (int i = 0; i < n; i++){
+            P1[i] = (A[i] % mod + mod) % mod;
+            P2[i] = (B[i] % mod + mod) % mod;
+        }
+
+        Modular op{(uint32_t)mod};
+        run<false>(op, (uint32_t*)P1.data(), n, conv_type);
+        run<false>(op, (uint32_t*)P2.data(), n, conv_type);
+
+        /// The 1/n factor of XOR is folded into the pointwise product
+        uint32_t scale = conv_type == XOR ? mod_inverse(n % mod, mod) : 1 % mod;
+        parallel_for(n, [&](int lo, int hi){
+            for (int i = lo; i < hi; i++) P1[i] = mod_mul(mod_mul(P1[i], P2[i], mod), scale, mod);
+        });
+
+        run<true>(op, (uint32_t*)P1.data(), n, conv_type);
+        return P1;
+    }
+
+    /***
+     * Subset convolution, C[mask] = sum of A[i] * B[j] over all i, j such that i | j = mask and i & j = 0
+     * Ranked zeta transforms reduce it to (log n + 1)^2 pointwise products, O(n log^2 n) overall with O(n log n) memory
+     *
+    ***/
+    vector <long long> subset_convolution(const vector <long long>& A, const vector <long long>& B){
+        int n = A.size(), k = __builtin_ctz(n);
+        assert(A.size() == B.size() && __builtin_popcount(n) == 1);
+
+        vector <uint64_t> a(A.begin(), A.end()), b(B.begin(), B.end());
+        auto f = ranked_zeta(Integer(), a, k), g = ranked_zeta(Integer(), b, k);
+
+        /// h_r = sum of f_i * g_(r - i), written over f_r from the highest rank down since lower ranks only need lower f
+        parallel_for(n, [&](int lo, int hi){
+            for (int r = k; r >= 0; r--){
+                uint64_t *fr = f.data() + (long long)r * n;
+                for (int i = lo; i < hi; i++) fr[i] *= g[i];
+                for (int j = 0; j < r; j++){
+                    const uint64_t *fj = f.data() + (long long)j * n, *gj = g.data() + (long long)(r - j) * n;
+                    for (int i = lo; i < hi; i++) fr[i] += fj[i] * gj[i];
+                }
+            }
+        }, BLOCK_SIZE);
+
+        auto res = unrank(Integer(), f, n, k);
+        return vector <long long>(res.begin(), res.end());
+    }
+
+    /***
+     * Same as subset_convolution(A, B), only values are calculated modulo mod
+     * mod must be below 2^31, values can be negative
+     *
+    ***/
+    vector <int> mod_subset_convolution(const vector <int>& A, const vector <int>& B, int mod){
+        int n = A.size(), k = __builtin_ctz(n);
+        assert(A.size() == B.size() && __builtin_popcount(n) == 1 && mod > 0);
+
+        vector <uint32_t> a(n), b(n);
+        for (int i = 0; i < n; i++){
+            a[i] = (A[i] % mod + mod) % mod;
+            b[i] = (B[i] % mod + mod) % mod;
+        }
+
+        Modular op{(uint32_t)mod};
+        auto f = ranked_zeta(op, a, k), g = ranked_zeta(op, b, k);
+
+        /// Every product is below 2^62, so the sums only need to be reduced once they reach 2^63
+        parallel_for(n, [&](int lo, int hi){
+            vector <uint64_t> acc(hi - lo);
+            for (int r = k; r >= 0; r--){
+                uint32_t *fr = f.data() + (long long)r * n;
+                for (int i = lo; i < hi; i++) acc[i - lo] = (uint64_t)fr[i] * g[i];
+                for (int j = 0; j < r; j++){
+                    const uint32_t *fj = f.data() + (long long)j * n, *gj = g.data() + (long long)(r - j) * n;
+                    for (int i = lo; i < hi; i++){
+                        uint64_t& x = acc[i - lo];
+                        x += (uint64_t)fj[i] * gj[i];
+                        if (x >> 63) x %= mod;
+                    }
+                }
+                for (int i = lo; i < hi; i++) fr[i] = acc[i - lo] % mod;
+            }
+        }, BLOCK_SIZE);
+
+        auto res = unrank(op, f, n, k);
+        return vector <int>(res.begin(), res.end());
+    }
 }
 
 int main(){
     const vector <long long> A = {0, 1, 3, 5};
     const vector <long long> B = {1, 1, 2, 1};
-    
+
     assert(fwht::or_convolution(A, B) == vector<long long>({0, 2, 9, 34}));
     assert(fwht::and_convolution(A, B) == vector<long long>({14, 7, 19, 5}));
     assert(fwht::xor_convolution(A, B) == vector<long long>({12, 14, 9, 10}));
 
+    /// Modular versions
+    const vector <int> C = {0, 1, 3, 5}, D = {1, 1, 2, 1};
+    assert(fwht::mod_convolution(C, D, fwht::OR, 7) == vector<int>({0, 2, 2, 6}));
+    assert(fwht::mod_convolution(C, D, fwht::AND, 7) == vector<int>({0, 0, 5, 5}));
+    assert(fwht::mod_convolution(C, D, fwht::XOR, 7) == vector<int>({5, 0, 2, 3}));
+
+    /// Only disjoint pairs, for example C[3] = A[0] * B[3] + A[1] * B[2] + A[2] * B[1] + A[3] * B[0]
+    assert(fwht::subset_convolution(A, B) == vector<long long>({0, 1, 3, 10}));
+    assert(fwht::mod_subset_convolution(C, D, 7) == vector<int>({0, 1, 3, 3}));
+
+    /// Sum over subsets and back
+    vector <long long> v = {1, 2, 3, 4};
+    fwht::subset_zeta(v.data(), 4);
+    assert(v == vector<long long>({1, 3, 4, 10}));
+    fwht::subset_mobius(v.data(), 4);
+    assert(v == vector<long long>({1, 2, 3, 4}));
+
+    /// Textbook transforms one level at a time, wrapping modulo 2^64, the convolution values are small enough to be exact
+    auto reference_convolution = [](vector<long long> a, vector<long long> b, int t){
+        int n = a.size();
+        auto run = [&](vector<long long>& v, bool inverse){
+            for (int s = 1; s < n; s <<= 1){
+                for (int i = 0; i < n; i += 2 * s){
+                    for (int j = i; j < i + s; j++){
+                        uint64_t u = v[j], w = v[j + s];
+                        if (t == fwht::OR) v[j + s] = inverse ? w - u : w + u;
+                        if (t == fwht::AND) v[j] = inverse ? u - w : u + w;
+                        if (t == fwht::XOR) v[j] = u + w, v[j + s] = u - w;
+                    }
+                }
+            }
+        };
+
+        run(a, false), run(b, false);
+        for (int i = 0; i < n; i++) a[i] = (uint64_t)a[i] * b[i];
+        run(a, true);
+        if (t == fwht::XOR) for (auto&& x: a) x /= n;
+        return a;
+    };
+
+    /// Cross-check all the methods against the naive definitions, exact values small enough not to overflow
+    /// Up to 2^20 so that several passes of fused levels run, and again on two threads so that they are split too
+    mt19937 rng(0);
+    const int mod = 998244353;
+    for (int threads = 1; threads <= 2; threads++){
+        fwht::set_threads(threads);
+        for (int n = 1; n <= (1 << 20); n <<= 1){
+            vector <long long> a(n), b(n), expected[3], mod_expected[3], subset(n, 0), mod_subset(n, 0);
+            vector <int> x(n), y(n);
+            for (int i = 0; i < n; i++){
+                a[i] = rng() % 1000 - 500, b[i] = rng() % 1000 - 500;
+                x[i] = rng() % mod, y[i] = rng() % mod;
+            }
+
+            if (n <= 256){
+                for (int t = 0; t < 3; t++) expected[t].assign(n, 0), mod_expected[t].assign(n, 0);
+                for (int i = 0; i < n; i++){
+                    for (int j = 0; j < n; j++){
+                        long long z = a[i] * b[j], w = (long long)x[i] * y[j] % mod;
+                        expected[fwht::OR][i | j] += z, mod_expected[fwht::OR][i | j] = (mod_expected[fwht::OR][i | j] + w) % mod;
+                        expected[fwht::AND][i & j] += z, mod_expected[fwht::AND][i & j] = (mod_expected[fwht::AND][i & j] + w) % mod;
+                        expected[fwht::XOR][i ^ j] += z, mod_expected[fwht::XOR][i ^ j] = (mod_expected[fwht::XOR][i ^ j] + w) % mod;
+                        if (!(i & j)) subset[i | j] += z, mod_subset[i | j] = (mod_subset[i | j] + w) % mod;
+                    }
+                }
+
+                for (int t = 0; t < 3; t++){
+                    assert(fwht::convolution(a, b, t) == expected[t]);
+                    auto res = fwht::mod_convolution(x, y, t, mod);
+                    assert(vector<long long>(res.begin(), res.end()) == mod_expected[t]);
+                }
+                assert(fwht::subset_convolution(a, b) == subset);
+
+                auto res = fwht::mod_subset_convolution(x, y, mod);
+                assert(vector<long long>(res.begin(), res.end()) == mod_subset);
+            }
+            else{
+                /// The exact results must match the textbook transforms, and reduced modulo mod the modular ones
+                vector <int> c(n), d(n);
+                for (int i = 0; i < n; i++) c[i] = a[i], d[i] = b[i];
+                for (int t = 0; t < 3; t++){
+                    auto res = fwht::convolution(a, b, t);
+                    auto mod_res = fwht::mod_convolution(c, d, t, mod);
+                    assert(res == reference_convolution(a, b, t));
+                    for (int i = 0; i < n; i++) assert(mod_res[i] == (res[i] % mod + mod) % mod);
+                }
+            }
+        }
+    }
+    fwht::set_threads(1);
+
+    clock_t start = clock();
+
+    vector <int> x(1 << 22), y(1 << 22);
+    for (int i = 0; i < (1 << 22); i++) x[i] = rng() % mod, y[i] = rng() % mod;
+    for (int t = 0; t < 3; t++) assert(fwht::mod_convolution(x, y, t, mod).size() == (1 << 22));
+
+    x.resize(1 << 18), y.resize(1 << 18);
+    assert(fwht::mod_subset_convolution(x, y, mod).size() == (1 << 18));
+
+    fprintf(stderr, "\nTime taken = %0.5f\n", (clock() - start) / (double)CLOCKS_PER_SEC);  /// Time taken = 0.72331
     return 0;
 }